@@ -7,6 +7,7 @@ let package = Package(
     name: "Playground",
     products: [
         .executable(name: "Playground", targets: ["Playground"]),
+        .executable(name: "ExecutorBenchmark", targets: ["ExecutorBenchmark"]),
     ],
     targets: [
         .target(
@@ -21,9 +22,18 @@ let package = Package(
                 .linkedLibrary("swift_Concurrency"),
                 .unsafeFlags(["-L/Library/Developer/Toolchains/swift-DEVELOPMENT-SNAPSHOT-2020-12-22-a.xctoolchain/usr/lib/swift/macosx/"]),
             ]),
+        .target(
+            name: "ExecutorBenchmark",
+            dependencies: ["SwiftInternal"]),
+        .target(
+            name: "ExecutorTests",
+            dependencies: ["SwiftInternal"],
+            cxxSettings: [
+                .headerSearchPath("../SwiftInternal"),
+            ]),
         .testTarget(
             name: "PlaygroundTests",
-            dependencies: ["Playground"]),
+            dependencies: ["Playground", "ExecutorTests"]),
     ],
     cxxLanguageStandard: .cxx14
 )
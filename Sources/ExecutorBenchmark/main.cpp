@@ -0,0 +1,158 @@
+//===--- main.cpp - Global executor queue benchmark -----------------------===//
+//
+// Measures the cost of enqueueing into the cooperative global queue as a
+// function of how many jobs are already queued.  With per-priority run
+// queues the cost per enqueue should stay flat from tens of queued jobs
+// up to millions.
+//
+// With "pingpong N", measures instead the time per hop of pairs of jobs
+// that keep enqueueing each other, one pair per worker on N workers, or
+// one pair on the calling thread if N is 0.
+//
+//===----------------------------------------------------------------------===//
+
+#include "swift/Runtime/Concurrency.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace swift;
+
+void insertIntoJobQueue(Job *newJob);
+Job *claimNextFromJobQueue();
+extern "C" void swiftInstallConcurrencyEnqueueHookWithWorkers(
+    size_t numWorkers);
+extern "C" size_t swiftExecutorRunFor(uint64_t maxNanos, size_t maxJobs);
+
+SWIFT_CC(swiftasync)
+static void unreachableJob(Job *job, ExecutorRef executor) {
+  abort();
+}
+
+static const JobPriority Priorities[] = {
+  JobPriority::Background, JobPriority::Utility, JobPriority::Default,
+  JobPriority::UserInitiated, JobPriority::UserInteractive,
+};
+
+/// Allocate \p count jobs with priorities cycling through the QoS classes.
+static std::vector<std::unique_ptr<Job>> makeJobs(size_t count) {
+  std::vector<std::unique_ptr<Job>> jobs;
+  jobs.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    auto priority = Priorities[i % (sizeof(Priorities) / sizeof(Priorities[0]))];
+    jobs.emplace_back(new Job(JobFlags(JobKind(1), priority), &unreachableJob));
+  }
+  return jobs;
+}
+
+static int runQueueBenchmark() {
+  const size_t measuredJobs = 100000;
+  auto measured = makeJobs(measuredJobs);
+
+  printf("%12s %16s %16s\n", "queued", "enqueue ns/job", "claim ns/job");
+  for (size_t queued = 10; queued <= 1000000; queued *= 10) {
+    auto background = makeJobs(queued);
+    for (auto &job : background)
+      insertIntoJobQueue(job.get());
+
+    auto start = std::chrono::steady_clock::now();
+    for (auto &job : measured)
+      insertIntoJobQueue(job.get());
+    auto enqueued = std::chrono::steady_clock::now();
+
+    size_t claimed = 0;
+    while (claimNextFromJobQueue())
+      ++claimed;
+    auto drained = std::chrono::steady_clock::now();
+
+    if (claimed != queued + measuredJobs) {
+      fprintf(stderr, "lost jobs: claimed %zu of %zu\n", claimed,
+              queued + measuredJobs);
+      return 1;
+    }
+
+    using nanoseconds = std::chrono::duration<double, std::nano>;
+    printf("%12zu %16.2f %16.2f\n", queued,
+           nanoseconds(enqueued - start).count() / measuredJobs,
+           nanoseconds(drained - enqueued).count() / claimed);
+  }
+  return 0;
+}
+
+struct Rally;
+
+/// One side of a rally, which hands the data to the other side.
+struct RallyJob : Job {
+  Rally *Owner;
+  RallyJob *Partner;
+
+  RallyJob(Rally *owner, JobInvokeFunction *run)
+    : Job(JobFlags(JobKind(1), JobPriority::Default), run), Owner(owner) {}
+};
+
+/// Two jobs that enqueue each other until HopsLeft runs out, each
+/// touching the data that the other handed it.
+struct Rally {
+  RallyJob Ping, Pong;
+  size_t HopsLeft;
+  unsigned char Data[4096] = {};
+
+  Rally(size_t hops, JobInvokeFunction *run)
+    : Ping(this, run), Pong(this, run), HopsLeft(hops) {
+    Ping.Partner = &Pong;
+    Pong.Partner = &Ping;
+  }
+};
+
+static std::atomic<size_t> RalliesInPlay{0};
+
+SWIFT_CC(swiftasync)
+static void hit(Job *job, ExecutorRef executor) {
+  auto side = static_cast<RallyJob*>(job);
+  auto rally = side->Owner;
+  for (size_t i = 0; i < sizeof(rally->Data); i += 64)
+    ++rally->Data[i];
+  if (--rally->HopsLeft == 0)
+    RalliesInPlay.fetch_sub(1, std::memory_order_release);
+  else
+    insertIntoJobQueue(side->Partner);
+}
+
+static int runPingPong(size_t numWorkers) {
+  const size_t hopsPerRally = 1000000;
+  if (numWorkers)
+    swiftInstallConcurrencyEnqueueHookWithWorkers(numWorkers);
+
+  std::vector<std::unique_ptr<Rally>> rallies;
+  for (size_t i = 0; i < std::max<size_t>(numWorkers, 1); ++i)
+    rallies.emplace_back(new Rally(hopsPerRally, &hit));
+  RalliesInPlay.store(rallies.size(), std::memory_order_relaxed);
+
+  auto start = std::chrono::steady_clock::now();
+  for (auto &rally : rallies)
+    insertIntoJobQueue(&rally->Ping);
+  while (RalliesInPlay.load(std::memory_order_acquire)) {
+    if (numWorkers)
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    else
+      swiftExecutorRunFor(0, 0);
+  }
+  auto finished = std::chrono::steady_clock::now();
+
+  using nanoseconds = std::chrono::duration<double, std::nano>;
+  printf("%zu rallies on %zu workers: %.2f ns/hop\n", rallies.size(),
+         numWorkers, nanoseconds(finished - start).count() / hopsPerRally);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1 && strcmp(argv[1], "pingpong") == 0)
+    return runPingPong(argc > 2 ? strtoul(argv[2], nullptr, 10) : 0);
+  return runQueueBenchmark();
+}
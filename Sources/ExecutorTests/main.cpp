@@ -0,0 +1,272 @@
+//===--- main.cpp - Tests of the global executor's data structures --------===//
+//
+// Exercises the lock-free queues and the timer wheel that the global
+// executor is built on, single-threaded for their ordering and limits
+// and with several threads for lost or duplicated jobs.  Prints each
+// failed check and exits with a non-zero status if there was any.
+//
+//===----------------------------------------------------------------------===//
+
+#include "swift/Runtime/Concurrency.h"
+#include "InjectionQueue.h"
+#include "TimerWheel.h"
+#include "WorkStealingDeque.h"
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace swift;
+using namespace my_swift;
+
+static unsigned NumFailures = 0;
+
+static void check(bool condition, const char *expression, int line) {
+  if (condition)
+    return;
+  fprintf(stderr, "line %d: check failed: %s\n", line, expression);
+  ++NumFailures;
+}
+
+#define CHECK(condition) check((condition), #condition, __LINE__)
+
+SWIFT_CC(swiftasync)
+static void unreachableJob(Job *job, ExecutorRef executor) {
+  abort();
+}
+
+/// A job that knows its place in the order the test created it in.
+struct TestJob : Job {
+  size_t Index;
+
+  explicit TestJob(size_t index)
+    : Job(JobFlags(JobKind(1), JobPriority::Default), &unreachableJob),
+      Index(index) {}
+};
+
+static std::vector<std::unique_ptr<TestJob>> makeJobs(size_t count) {
+  std::vector<std::unique_ptr<TestJob>> jobs;
+  jobs.reserve(count);
+  for (size_t i = 0; i < count; ++i)
+    jobs.emplace_back(new TestJob(i));
+  return jobs;
+}
+
+static size_t indexOf(Job *job) {
+  return static_cast<TestJob*>(job)->Index;
+}
+
+static void testInjectionQueueOrder() {
+  InjectionQueue queue;
+  auto jobs = makeJobs(5);
+  CHECK(queue.isEmpty());
+  CHECK(!queue.pop());
+
+  queue.push(jobs[0].get());
+  queue.push(jobs[1].get());
+  CHECK(!queue.isEmpty());
+
+  // A chain is linked through SchedulerPrivate[0], as the global queue
+  // links its jobs.
+  jobs[2]->SchedulerPrivate[0] = jobs[3].get();
+  jobs[3]->SchedulerPrivate[0] = jobs[4].get();
+  queue.pushChain(jobs[2].get(), jobs[4].get());
+
+  for (size_t i = 0; i < jobs.size(); ++i) {
+    auto job = queue.pop();
+    CHECK(job && indexOf(job) == i);
+  }
+  CHECK(!queue.pop());
+  CHECK(queue.isEmpty());
+
+  // The queue keeps working once it has been drained.
+  queue.push(jobs[0].get());
+  CHECK(queue.pop() == jobs[0].get());
+  CHECK(queue.isEmpty());
+}
+
+static void testInjectionQueueProducers() {
+  const size_t numProducers = 4, jobsPerProducer = 100000;
+  InjectionQueue queue;
+  auto jobs = makeJobs(numProducers * jobsPerProducer);
+
+  std::vector<std::thread> producers;
+  for (size_t p = 0; p < numProducers; ++p)
+    producers.emplace_back([&, p] {
+      for (size_t i = 0; i < jobsPerProducer; ++i)
+        queue.push(jobs[p * jobsPerProducer + i].get());
+    });
+
+  // Each producer's jobs must come out in the order it pushed them.
+  std::vector<size_t> nextFromProducer(numProducers, 0);
+  std::vector<bool> seen(jobs.size(), false);
+  size_t popped = 0;
+  while (popped < jobs.size()) {
+    auto job = queue.pop();
+    if (!job) {
+      std::this_thread::yield();
+      continue;
+    }
+    auto index = indexOf(job);
+    auto producer = index / jobsPerProducer;
+    CHECK(!seen[index]);
+    CHECK(index % jobsPerProducer == nextFromProducer[producer]);
+    seen[index] = true;
+    nextFromProducer[producer] = index % jobsPerProducer + 1;
+    ++popped;
+  }
+  for (auto &producer : producers)
+    producer.join();
+  CHECK(!queue.pop());
+  CHECK(queue.isEmpty());
+}
+
+static void testDequeOrderAndCapacity() {
+  WorkStealingDeque deque;
+  auto jobs = makeJobs(257);
+  CHECK(deque.isEmpty());
+  CHECK(!deque.steal());
+
+  size_t pushed = 0;
+  while (pushed < jobs.size() && deque.push(jobs[pushed].get()))
+    ++pushed;
+  CHECK(pushed == 256);
+  CHECK(deque.size() == 256);
+
+  // The owner and thieves alike claim the oldest job first.
+  for (size_t i = 0; i < 100; ++i) {
+    auto job = deque.steal();
+    CHECK(job && indexOf(job) == i);
+  }
+  CHECK(deque.size() == 156);
+
+  // Claiming made room, and the indices wrap around the slots.
+  CHECK(deque.push(jobs[256].get()));
+  for (size_t i = 100; i < jobs.size(); ++i) {
+    auto job = deque.steal();
+    CHECK(job && indexOf(job) == i);
+  }
+  CHECK(!deque.steal());
+  CHECK(deque.isEmpty());
+  CHECK(deque.size() == 0);
+}
+
+static void testDequeThieves() {
+  const size_t numThieves = 3, numJobs = 200000;
+  WorkStealingDeque deque;
+  auto jobs = makeJobs(numJobs);
+  std::unique_ptr<std::atomic<unsigned>[]> claims(
+      new std::atomic<unsigned>[numJobs]);
+  for (size_t i = 0; i < numJobs; ++i)
+    claims[i].store(0, std::memory_order_relaxed);
+  std::atomic<size_t> numClaimed{0};
+
+  auto claim = [&](Job *job) {
+    claims[indexOf(job)].fetch_add(1, std::memory_order_relaxed);
+    numClaimed.fetch_add(1, std::memory_order_relaxed);
+  };
+
+  std::vector<std::thread> thieves;
+  for (size_t t = 0; t < numThieves; ++t)
+    thieves.emplace_back([&] {
+      while (numClaimed.load(std::memory_order_relaxed) < numJobs) {
+        if (auto job = deque.steal())
+          claim(job);
+      }
+    });
+
+  // The owner pushes everything, claiming a job itself whenever the
+  // deque is full, as a worker would overflow elsewhere.
+  for (size_t i = 0; i < numJobs;) {
+    if (deque.push(jobs[i].get()))
+      ++i;
+    else if (auto job = deque.steal())
+      claim(job);
+  }
+  while (auto job = deque.steal())
+    claim(job);
+  for (auto &thief : thieves)
+    thief.join();
+
+  CHECK(numClaimed.load() == numJobs);
+  size_t numWrong = 0;
+  for (size_t i = 0; i < numJobs; ++i)
+    numWrong += claims[i].load() != 1;
+  CHECK(numWrong == 0);
+}
+
+static void testTimerWheelExpiry() {
+  const uint64_t start = 1000;
+  TimerWheel wheel(start);
+  CHECK(wheel.isEmpty());
+  CHECK(wheel.getNextWakeTick() == UINT64_MAX);
+
+  // Delays on either side of each level's span, so that timers are
+  // filed at every level and cascade down.
+  const uint64_t delays[] = {
+    1, 2, 63, 64, 65, 127, 4095, 4096, 4097, 262143, 262144, 300000,
+  };
+  const size_t numDelays = sizeof(delays) / sizeof(delays[0]);
+  auto jobs = makeJobs(numDelays);
+  for (size_t i = 0; i < numDelays; ++i)
+    wheel.insert(jobs[i].get(), start + delays[i]);
+  CHECK(!wheel.isEmpty());
+
+  std::vector<uint64_t> firedAt(numDelays, 0);
+  auto end = start + delays[numDelays - 1];
+  while (wheel.getCurrentTick() < end) {
+    auto next = wheel.getNextWakeTick();
+    CHECK(next > wheel.getCurrentTick());
+    // No timer may expire before the tick the wheel asked to wake at.
+    for (size_t i = 0; i < numDelays; ++i)
+      if (!firedAt[i])
+        CHECK(start + delays[i] >= next);
+    wheel.advance(next, [&](Job *job) {
+      firedAt[indexOf(job)] = wheel.getCurrentTick();
+    });
+  }
+  for (size_t i = 0; i < numDelays; ++i)
+    CHECK(firedAt[i] == start + delays[i]);
+  CHECK(wheel.isEmpty());
+  CHECK(wheel.getNextWakeTick() == UINT64_MAX);
+}
+
+static void testTimerWheelCancel() {
+  TimerWheel wheel(0);
+  auto jobs = makeJobs(3);
+  auto first = wheel.insert(jobs[0].get(), 10);
+  auto second = wheel.insert(jobs[1].get(), 10);
+  auto third = wheel.insert(jobs[2].get(), 5000);
+
+  CHECK(wheel.cancel(second) == jobs[1].get());
+  CHECK(!wheel.cancel(second));
+  CHECK(wheel.cancel(third) == jobs[2].get());
+
+  std::vector<Job *> fired;
+  wheel.advance(10000, [&](Job *job) { fired.push_back(job); });
+  CHECK(fired.size() == 1 && fired[0] == jobs[0].get());
+  CHECK(wheel.isEmpty());
+
+  // An ID stays stale after its timer has fired, even once its slot in
+  // the slab holds a new timer.
+  CHECK(!wheel.cancel(first));
+  auto reused = wheel.insert(jobs[0].get(), 10010);
+  CHECK(!wheel.cancel(first));
+  CHECK(wheel.cancel(reused) == jobs[0].get());
+}
+
+int main() {
+  testInjectionQueueOrder();
+  testInjectionQueueProducers();
+  testDequeOrderAndCapacity();
+  testDequeThieves();
+  testTimerWheelExpiry();
+  testTimerWheelCancel();
+  if (NumFailures) {
+    fprintf(stderr, "%u checks failed\n", NumFailures);
+    return 1;
+  }
+  printf("all checks passed\n");
+  return 0;
+}
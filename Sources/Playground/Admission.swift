@@ -0,0 +1,28 @@
+import SwiftInternal
+
+/// Thrown by `admitToGlobalExecutor` when the global executor is over
+/// its high-water mark under the reject policy, or under the drop-lowest
+/// policy when no queued task of lower priority can make room.
+public struct GlobalExecutorOverloaded: Error {}
+
+/// Ask the global executor's admission control whether new work of
+/// `priority`, by default the current task's, may start, e.g. before
+/// spawning a task.  Depending on the policy set with
+/// `swiftSetGlobalAdmissionPolicy`, this throws `GlobalExecutorOverloaded`
+/// or suspends until the queue has drained while the executor is
+/// overloaded.
+public func admitToGlobalExecutor(priority: Task.Priority? = nil) async throws {
+    let rawPriority = UInt8(truncatingIfNeeded: (priority ?? Task.currentPriority).rawValue)
+    var result = SwiftAdmissionAdmitted
+    await withUnsafeContinuation { (continuation: UnsafeContinuation<Void>) in
+        let context = ContinuationBox.retain(continuation)
+        result = swiftAdmitGlobalWork(rawPriority,
+                                      ContinuationBox.resumeAndRelease, context)
+        if result != SwiftAdmissionDeferred {
+            ContinuationBox.resumeAndRelease(context)
+        }
+    }
+    if result == SwiftAdmissionRejected {
+        throw GlobalExecutorOverloaded()
+    }
+}
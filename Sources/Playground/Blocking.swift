@@ -0,0 +1,28 @@
+import SwiftInternal
+
+/// Holds work while it is passed through C as a raw pointer.
+final class WorkBox {
+    let work: () -> Void
+
+    init(_ work: @escaping () -> Void) {
+        self.work = work
+    }
+
+    static let runAndRelease: @convention(c) (UnsafeMutableRawPointer?) -> Void = { context in
+        let box = Unmanaged<WorkBox>.fromOpaque(context!)
+            .takeRetainedValue()
+        box.work()
+    }
+}
+
+/// Run `body`, which may block, e.g. on a synchronous system call, on a
+/// thread of the blocking pool, and return its result.  The current task
+/// suspends meanwhile, so the global executor's threads keep running
+/// other tasks.
+public func runBlocking<T>(_ body: @escaping () -> T) async -> T {
+    return await withUnsafeContinuation { (continuation: UnsafeContinuation<T>) in
+        let box = WorkBox { continuation.resume(returning: body()) }
+        swiftRunBlocking(WorkBox.runAndRelease,
+                         Unmanaged.passRetained(box).toOpaque())
+    }
+}
@@ -0,0 +1,23 @@
+/// Holds a continuation while it is passed through C as a raw pointer.
+final class ContinuationBox {
+    let continuation: UnsafeContinuation<Void>
+
+    init(_ continuation: UnsafeContinuation<Void>) {
+        self.continuation = continuation
+    }
+
+    /// Box `continuation` and return a retained pointer to the box, to be
+    /// passed as the context of `resumeAndRelease`.
+    static func retain(_ continuation: UnsafeContinuation<Void>)
+        -> UnsafeMutableRawPointer {
+        return Unmanaged.passRetained(ContinuationBox(continuation)).toOpaque()
+    }
+
+    /// A C callback that resumes the continuation in a box made by
+    /// `retain` and releases the box.
+    static let resumeAndRelease: @convention(c) (UnsafeMutableRawPointer?) -> Void = { context in
+        let box = Unmanaged<ContinuationBox>.fromOpaque(context!)
+            .takeRetainedValue()
+        box.continuation.resume(returning: ())
+    }
+}
@@ -0,0 +1,36 @@
+import SwiftInternal
+
+/// A serial executor with a thread of its own, apart from the global
+/// executor's threads, for latency-critical work that should not wait
+/// behind other tasks.
+public final class DedicatedExecutor {
+    private let executor: OpaquePointer
+
+    /// Start the executor's thread, pinned to `cpus` unless it is empty.
+    /// If `interactive`, the thread asks for real-time scheduling.
+    public init(cpus: [UInt32] = [], interactive: Bool = false) {
+        executor = cpus.withUnsafeBufferPointer { buffer in
+            swiftCreateDedicatedExecutor(buffer.baseAddress, buffer.count,
+                                         interactive)
+        }
+    }
+
+    deinit {
+        swiftDestroyDedicatedExecutor(executor)
+    }
+
+    /// Whether the current thread is the executor's thread.
+    public var isCurrent: Bool {
+        return swiftIsOnDedicatedExecutor(executor)
+    }
+
+    /// Run `body` on the executor's thread, after the work enqueued before
+    /// it, and return its result.
+    public func run<T>(_ body: @escaping () -> T) async -> T {
+        return await withUnsafeContinuation { (continuation: UnsafeContinuation<T>) in
+            let box = WorkBox { continuation.resume(returning: body()) }
+            swiftRunOnDedicatedExecutor(executor, WorkBox.runAndRelease,
+                                        Unmanaged.passRetained(box).toOpaque())
+        }
+    }
+}
@@ -0,0 +1,59 @@
+import SwiftInternal
+
+/// Holds a continuation for the result of an I/O operation while it is
+/// passed through C as a raw pointer.
+private final class IOContinuationBox {
+    let continuation: UnsafeContinuation<Int32>
+
+    init(_ continuation: UnsafeContinuation<Int32>) {
+        self.continuation = continuation
+    }
+
+    static let resumeAndRelease: @convention(c) (UnsafeMutableRawPointer?, Int32) -> Void = { context, result in
+        let box = Unmanaged<IOContinuationBox>.fromOpaque(context!)
+            .takeRetainedValue()
+        box.continuation.resume(returning: result)
+    }
+}
+
+private func submitIO(_ operation: SwiftIOOperation, _ fd: Int32,
+                      _ buffer: UnsafeMutableRawPointer?, _ length: Int,
+                      _ offset: UInt64) async -> Int32 {
+    return await withUnsafeContinuation { (continuation: UnsafeContinuation<Int32>) in
+        let box = Unmanaged.passRetained(IOContinuationBox(continuation))
+        swiftSubmitGlobalIO(operation, fd, buffer,
+                            UInt32(clamping: length), offset,
+                            IOContinuationBox.resumeAndRelease,
+                            box.toOpaque())
+    }
+}
+
+/// Read into `buffer` from `fd`, at `offset` or at the file position if
+/// it is nil, without blocking an executor thread.  Returns the number
+/// of bytes read, or -errno.
+public func ioRead(_ fd: Int32, into buffer: UnsafeMutableRawBufferPointer,
+                   offset: UInt64? = nil) async -> Int {
+    return Int(await submitIO(SwiftIORead, fd, buffer.baseAddress,
+                              buffer.count, offset ?? UInt64.max))
+}
+
+/// Write `buffer` to `fd`, at `offset` or at the file position if it is
+/// nil, without blocking an executor thread.  Returns the number of
+/// bytes written, or -errno.
+public func ioWrite(_ fd: Int32, from buffer: UnsafeRawBufferPointer,
+                    offset: UInt64? = nil) async -> Int {
+    return Int(await submitIO(SwiftIOWrite, fd,
+                              UnsafeMutableRawPointer(mutating: buffer.baseAddress),
+                              buffer.count, offset ?? UInt64.max))
+}
+
+/// Accept a connection on the listening socket `fd`.  Returns the new,
+/// non-blocking socket, or -errno.
+public func ioAccept(_ fd: Int32) async -> Int32 {
+    return await submitIO(SwiftIOAccept, fd, nil, 0, 0)
+}
+
+/// Flush `fd` to stable storage.  Returns 0, or -errno.
+public func ioFsync(_ fd: Int32) async -> Int32 {
+    return await submitIO(SwiftIOFsync, fd, nil, 0, 0)
+}
@@ -0,0 +1,31 @@
+import SwiftInternal
+
+/// A serial executor that works like an actor without being one: its
+/// work waits in a lock-free mailbox and runs on the global executor's
+/// threads, one item at a time.
+public final class MailboxExecutor {
+    private let executor: OpaquePointer
+
+    public init() {
+        executor = swiftCreateMailboxExecutor()
+    }
+
+    deinit {
+        swiftDestroyMailboxExecutor(executor)
+    }
+
+    /// Whether the current thread is running the executor's work.
+    public var isCurrent: Bool {
+        return swiftIsOnMailboxExecutor(executor)
+    }
+
+    /// Run `body` on the executor, after the work enqueued before it, and
+    /// return its result.
+    public func run<T>(_ body: @escaping () -> T) async -> T {
+        return await withUnsafeContinuation { (continuation: UnsafeContinuation<T>) in
+            let box = WorkBox { continuation.resume(returning: body()) }
+            swiftRunOnMailboxExecutor(executor, WorkBox.runAndRelease,
+                                      Unmanaged.passRetained(box).toOpaque())
+        }
+    }
+}
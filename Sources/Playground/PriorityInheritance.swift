@@ -0,0 +1,15 @@
+import SwiftInternal
+
+extension Task.Handle {
+    /// Wait for the task's result like `get()`, but first escalate the
+    /// task to the priority of the waiting task, so that a high-priority
+    /// task does not wait behind low-priority work.  `get()` itself and
+    /// task groups do not do this.  The task's child tasks are escalated
+    /// too, but those already queued keep their place in the queue.
+    public func getInheritingPriority() async throws -> Success {
+        // A handle is a single reference to the runtime's AsyncTask.
+        swiftInheritPriority(unsafeBitCast(self, to: UnsafeMutableRawPointer.self),
+                             UInt8(truncatingIfNeeded: Task.currentPriority.rawValue))
+        return try await get()
+    }
+}
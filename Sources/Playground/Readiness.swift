@@ -0,0 +1,29 @@
+import SwiftInternal
+
+/// Suspend the current task until `fd` is ready for reading, without
+/// blocking the thread it was running on.  Readiness is only a hint:
+/// the next read may still fail with `EAGAIN`.
+public func readable(_ fd: Int32) async {
+    await waitUntilReady(fd, forWriting: false)
+}
+
+/// Suspend the current task until `fd` is ready for writing, without
+/// blocking the thread it was running on.
+public func writable(_ fd: Int32) async {
+    await waitUntilReady(fd, forWriting: true)
+}
+
+/// Resume every task suspended in `readable` or `writable` on `fd`, as
+/// if it were ready.  Call this before closing `fd` while tasks may be
+/// waiting on it; they would otherwise never resume.
+public func unwatch(_ fd: Int32) {
+    swiftUnwatchGlobalDescriptor(fd)
+}
+
+private func waitUntilReady(_ fd: Int32, forWriting: Bool) async {
+    await withUnsafeContinuation { (continuation: UnsafeContinuation<Void>) in
+        swiftScheduleGlobalCallbackWhenReady(fd, forWriting,
+                                             ContinuationBox.resumeAndRelease,
+                                             ContinuationBox.retain(continuation))
+    }
+}
@@ -0,0 +1,12 @@
+import SwiftInternal
+
+/// Suspend the current task for at least `nanoseconds` without blocking
+/// the thread it was running on.  The task is resumed by the global
+/// executor's timer wheel.
+public func asyncSleep(nanoseconds: UInt64) async {
+    await withUnsafeContinuation { (continuation: UnsafeContinuation<Void>) in
+        swiftScheduleGlobalCallbackAfter(nanoseconds,
+                                         ContinuationBox.resumeAndRelease,
+                                         ContinuationBox.retain(continuation))
+    }
+}
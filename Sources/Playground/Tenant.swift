@@ -0,0 +1,11 @@
+import SwiftInternal
+
+/// Run `operation` with the current task's jobs counted against
+/// `tenant`'s share of the global executor.  Tenants range from 1 to 63;
+/// give them weights with `swiftSetTenantWeight`.
+public func withTenant<T>(_ tenant: UInt32,
+                          operation: () async throws -> T) async rethrows -> T {
+    let scope = swiftBeginTenantScope(tenant)
+    defer { swiftEndTenantScope(scope) }
+    return try await operation()
+}
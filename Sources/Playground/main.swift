@@ -26,7 +26,7 @@ print("100")
 myRunAsyncAndBlock {
     print("A")
     await DispatchQueue.global().async()
-    sleep(10)
+    await asyncSleep(nanoseconds: 10_000_000_000)
     print("B")
 }
 import Foundation
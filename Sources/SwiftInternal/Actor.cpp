@@ -0,0 +1,319 @@
+//===--- Actor.cpp - Mailbox executor implementation ----------------------===//
+//
+// A serial executor that works like a default actor: it keeps its
+// pending jobs in an intrusive, lock-free multi-producer single-consumer
+// mailbox and borrows threads to run them.  An idle executor is drained
+// inline by the thread that enqueues on it, and a busy one by a job on
+// the global executor, for at most a quantum at a time.
+//
+// The Swift runtime's own default actors do not use this: the runtime
+// owns their PrivateData and their enqueue path, and swift_task_switch
+// and swift_task_enqueue cannot be interposed from this library.
+//
+//===----------------------------------------------------------------------===//
+
+#include "swift/Runtime/Concurrency.h"
+#include "swift/Runtime/ThreadLocal.h"
+#include "TaskPrivate.h"
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <type_traits>
+
+using namespace swift;
+using namespace my_swift;
+
+namespace {
+
+/// How many jobs, and for how many nanoseconds, an executor may run on a
+/// thread before it goes back to the global queue; 0 for no limit.
+static std::atomic<size_t> DrainQuantumJobs{64};
+static std::atomic<uint64_t> DrainQuantumNanos{1000000};
+
+/// Whether enqueuing on an idle executor drains it on the current thread.
+static std::atomic<bool> UseInlineDrain{true};
+
+/// How many executors a thread may be draining, one inside another,
+/// before it stops draining idle executors inline.  This bounds the
+/// stack that a chain of calls from one executor to the next can use.
+static constexpr uintptr_t MaxInlineDrainDepth = 4;
+
+/// How many jobs a drain runs between reads of the clock.  A read costs
+/// about as much as a short job, so a drain reads the clock only once it
+/// has more than one job to run, and then only this often.
+static constexpr size_t DrainClockInterval = 16;
+
+static SWIFT_RUNTIME_DECLARE_THREAD_LOCAL(uintptr_t, DrainDepth);
+
+class MailboxExecutor;
+
+/// The executor whose jobs the current thread is running, or null.
+static SWIFT_RUNTIME_DECLARE_THREAD_LOCAL(MailboxExecutor *, CurrentDrain);
+
+static uint64_t getCurrentNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/// What a mailbox executor is doing.
+enum class DrainState : uintptr_t {
+  /// No thread is draining the executor and no drain job is scheduled.
+  /// The mailbox is empty, or a producer that has just pushed a job is
+  /// about to claim the executor.
+  Idle,
+
+  /// The drain job is enqueued on the global executor.
+  Scheduled,
+
+  /// A thread is running the executor's jobs, from the drain job or
+  /// inline.
+  Running,
+};
+
+/// A serial executor whose jobs wait in a mailbox.
+///
+/// The mailbox is a Vyukov queue of jobs linked through
+/// SchedulerPrivate[0]: producers push with a single exchange on Head and
+/// never wait for each other or for the drainer, and only the drainer
+/// pops, at Tail.  A stub node keeps the queue from ever running dry
+/// between the two ends; only its link word exists, which is all the
+/// queue touches.  A null Head or Tail stands for the stub.
+///
+/// State is the single word that decides who drains the executor:
+/// whoever moves it out of Idle, either to Running to drain it inline or
+/// to Scheduled to leave it to the drain job.  The drain job is built in
+/// place each time, at the priority of the job that scheduled it.
+/// Whoever drains the executor holds a reference to it until it goes
+/// idle, so that it outlives destroyMailboxExecutor while it has jobs,
+/// and records the worker it runs on, if any, in LastWorker.  The drain
+/// job is directed at that worker, whose caches are likely to still hold
+/// the state that the jobs work on.
+class MailboxExecutor final : public SerialExecutor {
+  struct DrainJob : Job {
+    MailboxExecutor *Executor;
+
+    DrainJob(JobPriority priority, MailboxExecutor *executor)
+      : Job(JobFlags(getJobKind(LibraryJobKind::MailboxDrain), priority),
+            &drain),
+        Executor(executor) {}
+  };
+
+  std::aligned_storage<sizeof(DrainJob), alignof(DrainJob)>::type
+    DrainJobStorage;
+  std::atomic<Job*> StubNext{nullptr};
+  std::atomic<Job*> Head{nullptr};
+  Job *Tail = nullptr;
+  std::atomic<DrainState> State{DrainState::Idle};
+  std::atomic<size_t> RefCount{1};
+  JobPriority Priority;
+  unsigned LastWorker = 0;
+
+  static std::atomic<Job*> &nextInMailbox(Job *job) {
+    return reinterpret_cast<std::atomic<Job*>&>(job->SchedulerPrivate[0]);
+  }
+
+  Job *getStub() {
+    return reinterpret_cast<Job*>(&StubNext);
+  }
+
+  Job *getNode(Job *job) {
+    return job ? job : getStub();
+  }
+
+  void pushNode(Job *job) {
+    nextInMailbox(job).store(nullptr, std::memory_order_relaxed);
+    auto prev = Head.exchange(job, std::memory_order_seq_cst);
+    nextInMailbox(getNode(prev)).store(job, std::memory_order_release);
+  }
+
+  /// Take the oldest job, or return null if the mailbox is empty or a
+  /// producer has not finished linking the next job.  Only the drainer
+  /// may call this.
+  Job *pop() {
+    auto tail = getNode(Tail);
+    auto next = nextInMailbox(tail).load(std::memory_order_acquire);
+    if (tail == getStub()) {
+      if (!next)
+        return nullptr;
+      Tail = tail = next;
+      next = nextInMailbox(next).load(std::memory_order_acquire);
+    }
+    if (next) {
+      Tail = next;
+      return tail;
+    }
+    if (tail != getNode(Head.load(std::memory_order_acquire)))
+      return nullptr;
+    pushNode(getStub());
+    next = nextInMailbox(tail).load(std::memory_order_acquire);
+    if (next) {
+      Tail = next;
+      return tail;
+    }
+    return nullptr;
+  }
+
+  /// Whether the mailbox holds no job, not even one that a producer is
+  /// still linking.  Only the drainer may call this.
+  bool isEmpty() {
+    return getNode(Tail) == getStub() && !hasPushedSinceEmpty();
+  }
+
+  /// Whether a producer has pushed a job since the drainer last found
+  /// the mailbox empty.  Unlike isEmpty, this does not read Tail, so it
+  /// is safe once the drainer has let the executor go idle and another
+  /// thread may have claimed it.
+  bool hasPushedSinceEmpty() {
+    return getNode(Head.load(std::memory_order_seq_cst)) != getStub() ||
+           StubNext.load(std::memory_order_acquire);
+  }
+
+  void retain() {
+    RefCount.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void release() {
+    if (RefCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      delete this;
+  }
+
+  void scheduleDrain(JobPriority priority) {
+    auto job = new (&DrainJobStorage) DrainJob(priority, this);
+    enqueueGlobalOnWorker(job, LastWorker);
+  }
+
+  /// Go idle, unless a job arrives meanwhile and we take the executor
+  /// back instead, in which case State is Running again.  Returns whether
+  /// the executor went idle and the drainer's reference was released.
+  /// The mailbox must have been empty.
+  bool tryGoIdle() {
+    State.store(DrainState::Idle, std::memory_order_seq_cst);
+    auto expected = DrainState::Idle;
+    if (!hasPushedSinceEmpty() ||
+        !State.compare_exchange_strong(expected, DrainState::Running,
+                                       std::memory_order_seq_cst)) {
+      release();
+      return true;
+    }
+    return false;
+  }
+
+  /// Run the executor's jobs on the current thread until the mailbox is
+  /// empty or the quantum is used up, and then give up the drainer's
+  /// reference, either by going idle or by handing it to the drain job.
+  /// The caller must have moved State to Running.
+  void runQuantum(JobPriority priority) {
+    auto maxJobs = DrainQuantumJobs.load(std::memory_order_relaxed);
+    auto maxNanos = DrainQuantumNanos.load(std::memory_order_relaxed);
+    uint64_t start = 0;
+    size_t numRun = 0;
+    auto previousDrain = CurrentDrain.get();
+    CurrentDrain.set(this);
+    LastWorker = getCurrentGlobalWorker();
+    DrainDepth.set(DrainDepth.get() + 1);
+    while (true) {
+      bool quantumUsed = maxJobs && numRun >= maxJobs;
+      if (maxNanos && numRun == 1)
+        start = getCurrentNanos();
+      else if (maxNanos && numRun % DrainClockInterval == 1)
+        quantumUsed |= getCurrentNanos() - start >= maxNanos;
+      if (!quantumUsed) {
+        if (auto next = pop()) {
+          next->run(ExecutorRef::generic());
+          ++numRun;
+          continue;
+        }
+      }
+
+      // Either the quantum is used up, or a producer has pushed but not
+      // linked its job yet, which we let it finish instead of spinning.
+      // Go to the back of the global queue, behind the jobs that waited
+      // while we ran.
+      if (!isEmpty()) {
+        State.store(DrainState::Scheduled, std::memory_order_relaxed);
+        scheduleDrain(priority);
+        break;
+      }
+
+      if (tryGoIdle())
+        break;
+    }
+    CurrentDrain.set(previousDrain);
+    DrainDepth.set(DrainDepth.get() - 1);
+  }
+
+  SWIFT_CC(swiftasync)
+  static void drain(Job *job, ExecutorRef executor) {
+    auto self = static_cast<DrainJob*>(job)->Executor;
+    self->State.store(DrainState::Running, std::memory_order_relaxed);
+    self->runQuantum(job->getPriority());
+  }
+
+public:
+  explicit MailboxExecutor(JobPriority priority) : Priority(priority) {}
+
+  /// Drop the creator's reference.  The executor is freed once it has
+  /// run its jobs and gone idle.
+  void destroy() {
+    release();
+  }
+
+  void enqueue(Job *job) override {
+    // The job may run and be freed as soon as it is pushed.
+    auto priority = job->getPriority();
+    pushNode(job);
+    if (State.load(std::memory_order_seq_cst) != DrainState::Idle)
+      return;
+
+    // Only a thread of the global executor drains inline.  Any other,
+    // such as a thread of the blocking pool, a dedicated executor's or a
+    // C caller holding a lock, would be held up by the jobs it ran.
+    bool runInline = UseInlineDrain.load(std::memory_order_relaxed) &&
+                     DrainDepth.get() < MaxInlineDrainDepth &&
+                     isGlobalExecutorThread();
+    auto expected = DrainState::Idle;
+    if (!State.compare_exchange_strong(
+            expected, runInline ? DrainState::Running : DrainState::Scheduled,
+            std::memory_order_seq_cst))
+      return;
+    retain();
+    if (runInline)
+      runQuantum(priority);
+    else
+      scheduleDrain(priority);
+  }
+
+  bool isCurrent() const override {
+    return CurrentDrain.get() == this;
+  }
+
+  JobPriority getPriorityHint() const override {
+    return Priority;
+  }
+};
+
+} // end anonymous namespace
+
+SerialExecutor *my_swift::createMailboxExecutor(JobPriority priorityHint) {
+  return new MailboxExecutor(priorityHint);
+}
+
+void my_swift::destroyMailboxExecutor(SerialExecutor *executor) {
+  static_cast<MailboxExecutor *>(executor)->destroy();
+}
+
+void my_swift::setMailboxDrainQuantum(size_t maxJobs, uint64_t maxNanos) {
+  DrainQuantumJobs.store(maxJobs, std::memory_order_relaxed);
+  DrainQuantumNanos.store(maxNanos, std::memory_order_relaxed);
+}
+
+void my_swift::setMailboxInlineDrainEnabled(bool enabled) {
+  UseInlineDrain.store(enabled, std::memory_order_relaxed);
+}
+
+void my_swift::enqueueOnExecutor(Job *job, ExecutorRef executor) {
+  if (executor.isGeneric())
+    return swift_task_enqueueGlobal(job);
+  swift_task_enqueue(job, executor);
+}
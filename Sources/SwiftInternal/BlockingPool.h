@@ -0,0 +1,108 @@
+//===--- BlockingPool.h - Threads for blocking work -------------*- C++ -*-===//
+//
+// An elastic pool of threads for work that blocks, such as synchronous
+// file I/O or name lookups, so that it does not stall the threads of the
+// global executor.  Threads are started on demand up to a cap and exit
+// once they have been idle for a while.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef SWIFT_CONCURRENCY_BLOCKINGPOOL_H
+#define SWIFT_CONCURRENCY_BLOCKINGPOOL_H
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace my_swift {
+
+/// Runs callbacks that may block on threads of their own.
+///
+/// A callback is handed to an idle thread if there is one, and otherwise
+/// to a new thread while there are fewer than the cap.  Beyond that,
+/// callbacks wait in FIFO order for a thread to finish.  The pool's
+/// threads are detached, so the pool must never be destroyed.
+class BlockingPool {
+  using Callback = std::pair<void (*)(void *), void *>;
+
+  std::mutex Lock;
+  std::condition_variable WorkAvailable;
+
+  /// Callbacks that no thread has taken yet.
+  std::deque<Callback> Pending;
+
+  unsigned NumThreads = 0;
+
+  /// The threads waiting for a callback.  Each of them takes one of
+  /// Pending once it wakes up, so a new callback only needs a new thread
+  /// if there are no more idle threads than pending callbacks.
+  unsigned NumIdle = 0;
+
+  unsigned MaxThreads;
+  std::chrono::nanoseconds IdleTimeout;
+
+  void runThread() {
+    std::unique_lock<std::mutex> guard(Lock);
+    while (true) {
+      if (!Pending.empty()) {
+        auto callback = Pending.front();
+        Pending.pop_front();
+        guard.unlock();
+        callback.first(callback.second);
+        guard.lock();
+        continue;
+      }
+
+      ++NumIdle;
+      bool hasWork = WorkAvailable.wait_for(guard, IdleTimeout,
+                                            [&] { return !Pending.empty(); });
+      --NumIdle;
+      if (!hasWork) {
+        --NumThreads;
+        return;
+      }
+    }
+  }
+
+public:
+  BlockingPool(unsigned maxThreads, uint64_t idleTimeoutNanos)
+    : MaxThreads(std::max(maxThreads, 1u)), IdleTimeout(idleTimeoutNanos) {}
+
+  BlockingPool(const BlockingPool &) = delete;
+  BlockingPool &operator=(const BlockingPool &) = delete;
+
+  /// Change the cap and the time after which idle threads exit.  Lowering
+  /// the cap does not stop threads that are running callbacks; the pool
+  /// shrinks as they go idle and time out.
+  void setLimits(unsigned maxThreads, uint64_t idleTimeoutNanos) {
+    std::lock_guard<std::mutex> guard(Lock);
+    MaxThreads = std::max(maxThreads, 1u);
+    IdleTimeout = std::chrono::nanoseconds(idleTimeoutNanos);
+  }
+
+  /// Call \p fn with \p context on a thread of the pool.
+  void run(void (*fn)(void *), void *context) {
+    bool startThread = false;
+    {
+      std::lock_guard<std::mutex> guard(Lock);
+      Pending.emplace_back(fn, context);
+      if (NumIdle < Pending.size() && NumThreads < MaxThreads) {
+        ++NumThreads;
+        startThread = true;
+      }
+    }
+    if (startThread)
+      std::thread([this] { runThread(); }).detach();
+    else
+      WorkAvailable.notify_one();
+  }
+};
+
+} // end namespace my_swift
+
+#endif
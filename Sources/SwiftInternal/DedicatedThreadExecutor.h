@@ -0,0 +1,181 @@
+//===--- DedicatedThreadExecutor.h - Executor on its own thread -*- C++ -*-===//
+//
+// A serial executor that runs its jobs on a thread of its own, apart
+// from the global executor's threads, optionally pinned to a set of CPUs
+// that can be isolated from the rest of the process.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef SWIFT_CONCURRENCY_DEDICATEDTHREADEXECUTOR_H
+#define SWIFT_CONCURRENCY_DEDICATEDTHREADEXECUTOR_H
+
+#include "swift/Runtime/Concurrency.h"
+#include "swift/ABI/Task.h"
+#include "TaskPrivate.h"
+#include "ThreadParker.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace my_swift {
+
+/// A serial executor with a dedicated thread and run loop.
+///
+/// Jobs wait in a FIFO list, linked through SchedulerPrivate[0], that
+/// the thread takes whole and runs without holding the lock.  When it
+/// runs out of jobs, the thread spins briefly before it blocks, to pick
+/// up the next job quickly.  If the priority hint is UserInteractive,
+/// the thread asks for SCHED_FIFO, which usually needs privileges, and
+/// otherwise runs at normal priority.
+///
+/// Destroying the executor runs the jobs that are already enqueued and
+/// stops the thread; jobs enqueued after that go to the global executor.
+/// It joins the thread unless it is destroyed from one of its own jobs,
+/// in which case the thread finishes on its own.
+class DedicatedThreadExecutor final : public SerialExecutor {
+  static swift::Job *&nextInQueue(swift::Job *job) {
+    return reinterpret_cast<swift::Job*&>(job->SchedulerPrivate[0]);
+  }
+
+  /// The state that the thread works on.  The thread shares it, so that
+  /// it can outlive the executor.
+  struct RunLoop {
+    std::mutex Lock;
+    swift::Job *First = nullptr;
+    swift::Job *Last = nullptr;
+    bool IsStopping = false;
+
+    /// Whether First is non-null or IsStopping is set, for the thread to
+    /// check without taking the lock.
+    std::atomic<bool> HasWork{false};
+
+    ThreadParker Idle;
+    swift::JobPriority Priority;
+    std::vector<unsigned> CPUs;
+    std::atomic<std::thread::id> ThreadID{std::thread::id()};
+
+    RunLoop(swift::JobPriority priority, std::vector<unsigned> cpus)
+      : Priority(priority), CPUs(std::move(cpus)) {}
+
+    void configureThread() {
+#if defined(__linux__)
+      if (!CPUs.empty()) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (auto cpu : CPUs)
+          if (cpu < CPU_SETSIZE)
+            CPU_SET(cpu, &cpus);
+        (void)pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+      }
+      if (Priority == swift::JobPriority::UserInteractive) {
+        struct sched_param param = {};
+        param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+        (void)pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+      }
+#endif
+    }
+
+    void run() {
+      ThreadID.store(std::this_thread::get_id(), std::memory_order_release);
+      configureThread();
+      while (true) {
+        Idle.park([this] { return HasWork.load(std::memory_order_acquire); });
+        swift::Job *job;
+        {
+          std::lock_guard<std::mutex> guard(Lock);
+          if (!First) {
+            if (IsStopping)
+              return;
+            continue;
+          }
+          job = First;
+          First = Last = nullptr;
+          HasWork.store(IsStopping, std::memory_order_relaxed);
+        }
+        while (job) {
+          // The job may be freed or enqueued again once it runs.
+          auto next = nextInQueue(job);
+          job->run(swift::ExecutorRef::generic());
+          job = next;
+        }
+      }
+    }
+
+    /// Add \p job to the list, unless the executor is stopping.  Returns
+    /// whether it was added.
+    bool push(swift::Job *job) {
+      nextInQueue(job) = nullptr;
+      {
+        std::lock_guard<std::mutex> guard(Lock);
+        if (IsStopping)
+          return false;
+        if (Last)
+          nextInQueue(Last) = job;
+        else
+          First = job;
+        Last = job;
+        HasWork.store(true, std::memory_order_relaxed);
+      }
+      Idle.unparkOne();
+      return true;
+    }
+
+    void stop() {
+      {
+        std::lock_guard<std::mutex> guard(Lock);
+        IsStopping = true;
+        HasWork.store(true, std::memory_order_relaxed);
+      }
+      Idle.unparkOne();
+    }
+  };
+
+  std::shared_ptr<RunLoop> Loop;
+  std::thread Thread;
+
+public:
+  /// Start the executor's thread, pinned to \p cpus unless that is empty.
+  explicit DedicatedThreadExecutor(
+      swift::JobPriority priority = swift::JobPriority::Default,
+      std::vector<unsigned> cpus = {})
+    : Loop(std::make_shared<RunLoop>(priority, std::move(cpus))),
+      Thread([loop = Loop] { loop->run(); }) {}
+
+  DedicatedThreadExecutor(const DedicatedThreadExecutor &) = delete;
+  DedicatedThreadExecutor &operator=(const DedicatedThreadExecutor &) = delete;
+
+  ~DedicatedThreadExecutor() {
+    Loop->stop();
+    // A thread cannot join itself.
+    if (isCurrent())
+      Thread.detach();
+    else
+      Thread.join();
+  }
+
+  void enqueue(swift::Job *job) override {
+    if (!Loop->push(job))
+      swift_task_enqueueGlobal(job);
+  }
+
+  bool isCurrent() const override {
+    return Loop->ThreadID.load(std::memory_order_acquire) ==
+           std::this_thread::get_id();
+  }
+
+  swift::JobPriority getPriorityHint() const override {
+    return Loop->Priority;
+  }
+};
+
+} // end namespace my_swift
+
+#endif
@@ -0,0 +1,326 @@
+//===--- FairQueue.h - Fair queuing across tenants --------------*- C++ -*-===//
+//
+// Deficit round robin across tenants for the global executor.  Tasks
+// tag themselves with a tenant in a table kept by this library, and
+// each priority level of the global queue serves its tenants in
+// proportion to their weights, measured in CPU time.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef SWIFT_CONCURRENCY_FAIRQUEUE_H
+#define SWIFT_CONCURRENCY_FAIRQUEUE_H
+
+#include "swift/ABI/Task.h"
+#include "llvm/Support/MathExtras.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+
+namespace my_swift {
+
+/// The number of tenants, including tenant 0, which stands for the jobs
+/// that carry no tenant.
+enum : unsigned { MaxTenants = 64 };
+
+/// A scope in which a task's jobs are in the given tenant's share of
+/// the global executor.
+///
+/// Scopes are kept in a TenantTable rather than registered with the
+/// task as status records: the record kinds that the runtime does not
+/// define are reserved to it, and it need not skip ones it does not
+/// know.
+class TenantScope {
+  friend class TenantTable;
+
+  swift::AsyncTask *Task;
+  unsigned Tenant;
+
+  /// The next scope in the same bucket of the table.  The scopes of a
+  /// task are in it innermost first.
+  TenantScope *Next = nullptr;
+
+public:
+  TenantScope(swift::AsyncTask *task, unsigned tenant)
+    : Task(task), Tenant(tenant) {
+    assert(tenant > 0 && tenant < MaxTenants && "tenant out of range");
+  }
+
+  /// The task that the scope tags.
+  swift::AsyncTask *getTask() const { return Task; }
+
+  unsigned getTenant() const { return Tenant; }
+};
+
+/// The tenant scopes of all tasks, hashed by task.
+///
+/// A task begins and ends its own scopes, but any thread that enqueues
+/// one of its jobs looks up its tenant, so each bucket has a lock.
+class TenantTable {
+  enum : unsigned { NumBuckets = 64 };
+
+  struct Bucket {
+    std::mutex Lock;
+
+    /// Written under Lock, but read without it to skip empty buckets.
+    std::atomic<TenantScope*> Head{nullptr};
+  };
+
+  Bucket Buckets[NumBuckets];
+
+  Bucket &getBucket(const swift::AsyncTask *task) {
+    auto hash = uintptr_t(task) >> 4;
+    return Buckets[(hash ^ (hash >> 6)) % NumBuckets];
+  }
+
+public:
+  TenantTable() = default;
+  TenantTable(const TenantTable &) = delete;
+  TenantTable &operator=(const TenantTable &) = delete;
+
+  /// Make \p scope its task's innermost one.
+  void insert(TenantScope *scope) {
+    auto &bucket = getBucket(scope->Task);
+    std::lock_guard<std::mutex> guard(bucket.Lock);
+    scope->Next = bucket.Head.load(std::memory_order_relaxed);
+    bucket.Head.store(scope, std::memory_order_release);
+  }
+
+  void remove(TenantScope *scope) {
+    auto &bucket = getBucket(scope->Task);
+    std::lock_guard<std::mutex> guard(bucket.Lock);
+    auto head = bucket.Head.load(std::memory_order_relaxed);
+    if (head == scope) {
+      bucket.Head.store(scope->Next, std::memory_order_release);
+      return;
+    }
+    for (auto prev = head; prev; prev = prev->Next) {
+      if (prev->Next == scope) {
+        prev->Next = scope->Next;
+        return;
+      }
+    }
+    assert(false && "tenant scope is not in the table");
+  }
+
+  /// The tenant of \p task's innermost scope, or 0 if it has none.
+  unsigned getTenant(const swift::AsyncTask *task) {
+    auto &bucket = getBucket(task);
+    if (!bucket.Head.load(std::memory_order_acquire))
+      return 0;
+    std::lock_guard<std::mutex> guard(bucket.Lock);
+    for (auto scope = bucket.Head.load(std::memory_order_relaxed); scope;
+         scope = scope->Next) {
+      if (scope->Task == task)
+        return scope->Tenant;
+    }
+    return 0;
+  }
+};
+
+/// The CPU time that each tenant may still use in the current round,
+/// shared by the FairQueues of every priority level.
+///
+/// A tenant is charged an estimate of a job's cost when the job is
+/// dequeued, and the difference once it has run and its cost is known,
+/// so that threads dequeuing concurrently see a close balance.
+class TenantAccounts {
+  enum : int64_t {
+    /// The CPU time per round of a tenant of weight 1.
+    QuantumNanos = 100000,
+
+    /// A tenant's debt is capped at this many rounds, so that one long
+    /// job does not shut its tenant out for long and finding a tenant
+    /// with credit stays cheap.
+    MaxDebtRounds = 4,
+  };
+
+  std::atomic<int64_t> Balances[MaxTenants];
+  std::atomic<int64_t> AverageCosts[MaxTenants];
+  std::atomic<uint32_t> Weights[MaxTenants];
+
+  int64_t getQuantum(unsigned tenant) const {
+    return QuantumNanos * Weights[tenant].load(std::memory_order_relaxed);
+  }
+
+public:
+  TenantAccounts() {
+    for (unsigned tenant = 0; tenant < MaxTenants; ++tenant) {
+      Balances[tenant].store(0, std::memory_order_relaxed);
+      AverageCosts[tenant].store(0, std::memory_order_relaxed);
+      Weights[tenant].store(1, std::memory_order_relaxed);
+    }
+  }
+
+  TenantAccounts(const TenantAccounts &) = delete;
+  TenantAccounts &operator=(const TenantAccounts &) = delete;
+
+  void setWeight(unsigned tenant, uint32_t weight) {
+    Weights[tenant].store(std::max<uint32_t>(weight, 1),
+                          std::memory_order_relaxed);
+  }
+
+  bool hasCredit(unsigned tenant) const {
+    return Balances[tenant].load(std::memory_order_relaxed) > 0;
+  }
+
+  /// Give a tenant its quantum for the next round.
+  void grant(unsigned tenant) {
+    Balances[tenant].fetch_add(getQuantum(tenant), std::memory_order_relaxed);
+  }
+
+  /// Drop a tenant's unused credit, because it has run out of jobs.
+  /// Debts are kept.
+  void forfeit(unsigned tenant) {
+    auto balance = Balances[tenant].load(std::memory_order_relaxed);
+    while (balance > 0 &&
+           !Balances[tenant].compare_exchange_weak(balance, 0,
+                                                   std::memory_order_relaxed))
+      ;
+  }
+
+  /// Charge a tenant the estimated cost of a job that is about to run,
+  /// and return the estimate.
+  int64_t chargeEstimate(unsigned tenant) {
+    auto estimate = AverageCosts[tenant].load(std::memory_order_relaxed);
+    charge(tenant, estimate);
+    return estimate;
+  }
+
+  /// Settle the cost of a job that was charged \p estimate when it was
+  /// dequeued and has now run for \p costNanos.
+  void settle(unsigned tenant, int64_t estimate, int64_t costNanos) {
+    auto average = AverageCosts[tenant].load(std::memory_order_relaxed);
+    AverageCosts[tenant].store(average + (costNanos - average) / 8,
+                               std::memory_order_relaxed);
+    charge(tenant, costNanos - estimate);
+  }
+
+  void charge(unsigned tenant, int64_t nanos) {
+    auto floor = -MaxDebtRounds * getQuantum(tenant);
+    auto balance =
+      Balances[tenant].fetch_sub(nanos, std::memory_order_relaxed) - nanos;
+    if (balance < floor)
+      Balances[tenant].fetch_add(floor - balance, std::memory_order_relaxed);
+  }
+};
+
+/// The jobs of one priority level, in one FIFO per tenant, served by
+/// deficit round robin.
+///
+/// The tenants with jobs form a ring.  The tenant at the front is
+/// served for as long as it has credit; then it is granted its quantum
+/// and moves to the back.  Tenant 0 has no FIFO here: its jobs are the
+/// level's ordinary ones, kept by the caller, which tells the ring
+/// whether it has any.
+///
+/// Jobs are linked through SchedulerPrivate[0].  This class is not
+/// thread-safe.
+class FairQueue {
+  swift::Job *Heads[MaxTenants] = {};
+  swift::Job *Tails[MaxTenants] = {};
+
+  /// Bit N is set iff tenant N is in the ring.
+  uint64_t Active = 0;
+
+  /// Bit N is set iff tenant N > 0 has a job here.
+  uint64_t Backlogged = 0;
+
+  uint8_t RingNext[MaxTenants];
+  uint8_t RingPrev[MaxTenants];
+  unsigned Front = 0;
+
+  static swift::Job *&nextInQueue(swift::Job *job) {
+    return reinterpret_cast<swift::Job*&>(job->SchedulerPrivate[0]);
+  }
+
+  void linkToRing(unsigned tenant) {
+    auto bit = uint64_t(1) << tenant;
+    if (Active & bit)
+      return;
+    if (!Active) {
+      RingNext[tenant] = RingPrev[tenant] = uint8_t(tenant);
+      Front = tenant;
+    } else {
+      // Join at the back, just before the front.
+      auto back = RingPrev[Front];
+      RingNext[back] = uint8_t(tenant);
+      RingPrev[tenant] = uint8_t(back);
+      RingNext[tenant] = uint8_t(Front);
+      RingPrev[Front] = uint8_t(tenant);
+    }
+    Active |= bit;
+  }
+
+  void unlinkFromRing(unsigned tenant) {
+    auto bit = uint64_t(1) << tenant;
+    if (!(Active & bit))
+      return;
+    Active &= ~bit;
+    if (!Active)
+      return;
+    RingNext[RingPrev[tenant]] = RingNext[tenant];
+    RingPrev[RingNext[tenant]] = RingPrev[tenant];
+    if (Front == tenant)
+      Front = RingNext[tenant];
+  }
+
+public:
+  FairQueue() = default;
+  FairQueue(const FairQueue &) = delete;
+  FairQueue &operator=(const FairQueue &) = delete;
+
+  /// Whether any tenant other than tenant 0 has a job here.
+  bool hasTaggedJobs() const { return Backlogged != 0; }
+
+  void push(swift::Job *job, unsigned tenant) {
+    assert(tenant > 0 && tenant < MaxTenants && "not a tagged tenant");
+    nextInQueue(job) = nullptr;
+    if (Tails[tenant])
+      nextInQueue(Tails[tenant]) = job;
+    else
+      Heads[tenant] = job;
+    Tails[tenant] = job;
+    Backlogged |= uint64_t(1) << tenant;
+    linkToRing(tenant);
+  }
+
+  /// Tell the ring whether tenant 0 has jobs.
+  void setUntaggedBacklogged(bool backlogged, TenantAccounts &accounts) {
+    if (backlogged) {
+      linkToRing(0);
+    } else if (Active & 1) {
+      unlinkFromRing(0);
+      accounts.forfeit(0);
+    }
+  }
+
+  /// Choose the tenant to serve next.  The ring must not be empty.
+  unsigned chooseTenant(TenantAccounts &accounts) {
+    assert(Active && "no tenant has jobs");
+    while (!accounts.hasCredit(Front)) {
+      accounts.grant(Front);
+      Front = RingNext[Front];
+    }
+    return Front;
+  }
+
+  /// Take the first job of a tenant other than tenant 0.
+  swift::Job *take(unsigned tenant, TenantAccounts &accounts) {
+    auto job = Heads[tenant];
+    Heads[tenant] = nextInQueue(job);
+    if (!Heads[tenant]) {
+      Tails[tenant] = nullptr;
+      Backlogged &= ~(uint64_t(1) << tenant);
+      unlinkFromRing(tenant);
+      accounts.forfeit(tenant);
+    }
+    return job;
+  }
+};
+
+} // end namespace my_swift
+
+#endif
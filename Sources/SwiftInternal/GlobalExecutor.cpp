@@ -47,60 +47,2654 @@
 ///
 /// This file defines Swift's interface to that global executor.
 ///
-/// The default implementation is backed by libdispatch, but there
-/// may be good reasons to provide alternatives (e.g. when building
-/// a single-threaded runtime).
+/// The default implementation is cooperative: jobs run on threads that
+/// are donated to it, or on its own pool of worker threads.  It can be
+/// backed by libdispatch instead, which is decided when the enqueue hook
+/// is installed.
 ///
 ///===----------------------------------------------------------------------===///
 
 #include "swift/Runtime/Concurrency.h"
 #include "TaskPrivate.h"
+#include "BlockingPool.h"
+#include "FairQueue.h"
+#include "InjectionQueue.h"
+#include "IOUring.h"
+#include "NUMATopology.h"
+#include "Reactor.h"
+#include "ThreadParker.h"
+#include "TimerWheel.h"
+#include "WorkStealingDeque.h"
+#include "swift/Runtime/Debug.h"
+#include "swift/Runtime/ThreadLocal.h"
+#include "llvm/Support/MathExtras.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <mutex>
+#include <thread>
+#include <vector>
 
-#if !SWIFT_CONCURRENCY_COOPERATIVE_GLOBAL_EXECUTOR
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#endif
+#include <time.h>
+#include <unistd.h>
+
+#if SWIFT_CONCURRENCY_ENABLE_DISPATCH
 #include <dispatch/dispatch.h>
 #endif
 
 using namespace swift;
-
-static Job *JobQueue = nullptr;
+using namespace my_swift;
 
 /// Get the next-in-queue storage slot.
 static Job *&nextInQueue(Job *cur) {
   return reinterpret_cast<Job*&>(cur->SchedulerPrivate);
 }
 
-/// Insert a job into the cooperative global queue.
-void insertIntoJobQueue(Job *newJob) {
-  Job **position = &JobQueue;
-  while (auto cur = *position) {
-    // If we find a job with lower priority, insert here.
-    if (cur->getPriority() < newJob->getPriority()) {
-      nextInQueue(newJob) = cur;
-      *position = newJob;
+/// Get the back-pointer storage slot.  While a job waits in one of the
+/// global queue's FIFOs, this points to the previous job, or holds
+/// FIFOHeadMarker if the job is at the head.  Otherwise it means nothing:
+/// nothing initializes it, and other queues may have used it.
+static Job *&prevInQueue(Job *cur) {
+  return reinterpret_cast<Job*&>(cur->SchedulerPrivate[1]);
+}
+
+/// The back-pointer of the job at the head of a FIFO.  Jobs are aligned,
+/// so this can never be the address of one.
+static Job *const FIFOHeadMarker = reinterpret_cast<Job*>(uintptr_t(1));
+
+/// A job flag, among the bits that JobFlags reserves for generic job
+/// flags, that is set while the job waits in one of the global queue's
+/// FIFOs, and so while its back-pointer can be trusted.  Jobs are built
+/// with it clear, and only the owner of the global queue changes it.
+static constexpr size_t JobQueuedInFIFOFlag = size_t(1) << 16;
+
+static bool isQueuedInFIFO(Job *job) {
+  return job->Flags.getOpaqueValue() & JobQueuedInFIFOFlag;
+}
+
+static void setQueuedInFIFO(Job *job, bool queued) {
+  auto bits = job->Flags.getOpaqueValue();
+  job->Flags = JobFlags(queued ? bits | JobQueuedInFIFOFlag
+                               : bits & ~JobQueuedInFIFOFlag);
+}
+
+/// Whether jobs whose tasks carry a deadline are run earliest deadline
+/// first within their priority level.
+static std::atomic<bool> UseDeadlineScheduling{false};
+
+/// If deadline scheduling is enabled and \p job is a task with an active
+/// DeadlineStatusRecord, find its nearest deadline.
+///
+/// A task's status records may only be read synchronously with the
+/// task, but a task that is being enqueued is not running anywhere, so
+/// its records are stable here.
+static bool getSchedulingDeadline(Job *job, TaskDeadline &deadline) {
+  if (!UseDeadlineScheduling.load(std::memory_order_relaxed))
+    return false;
+  auto task = dyn_cast<AsyncTask>(job);
+  if (!task)
+    return false;
+
+  bool found = false;
+  auto status = task->Status.load(std::memory_order_acquire);
+  for (auto record : status.records()) {
+    if (auto deadlineRecord = dyn_cast<DeadlineStatusRecord>(record)) {
+      auto recordDeadline = deadlineRecord->getDeadline();
+      if (!found || recordDeadline < deadline)
+        deadline = recordDeadline;
+      found = true;
+    }
+  }
+  return found;
+}
+
+void my_swift::setDeadlineSchedulingEnabled(bool enabled) {
+  UseDeadlineScheduling.store(enabled, std::memory_order_relaxed);
+}
+
+/// Whether any task has been tagged with a tenant or any tenant has been
+/// given a weight.  Until then, the global queue ignores tenants.
+static std::atomic<bool> UseTenantScheduling{false};
+
+/// The tenants' weights and balances.  Like JobQueue, this is never
+/// destroyed.
+static TenantAccounts &Tenants = *new TenantAccounts();
+
+/// The tenant scopes that tasks are in.  Like JobQueue, this is never
+/// destroyed.
+static TenantTable &TenantScopes = *new TenantTable();
+
+/// If tenant scheduling is in use and \p job is a task in a tenant
+/// scope, return the tenant of the innermost one, or 0.
+static unsigned getSchedulingTenant(Job *job) {
+  if (!UseTenantScheduling.load(std::memory_order_relaxed))
+    return 0;
+  auto task = dyn_cast<AsyncTask>(job);
+  if (!task)
+    return 0;
+  return TenantScopes.getTenant(task);
+}
+
+void my_swift::setTenantWeight(unsigned tenant, uint32_t weight) {
+  assert(tenant < MaxTenants && "tenant out of range");
+  Tenants.setWeight(tenant, weight);
+  UseTenantScheduling.store(true, std::memory_order_relaxed);
+}
+
+TenantScope *my_swift::beginTenantScope(AsyncTask *task, unsigned tenant) {
+  if (tenant == 0 || tenant >= MaxTenants)
+    return nullptr;
+  UseTenantScheduling.store(true, std::memory_order_relaxed);
+  auto scope = new TenantScope(task, tenant);
+  TenantScopes.insert(scope);
+  return scope;
+}
+
+void my_swift::endTenantScope(TenantScope *scope) {
+  if (!scope)
+    return;
+  TenantScopes.remove(scope);
+  delete scope;
+}
+
+static uint64_t getCurrentNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/// The CPU time that the current thread has used, or if that cannot be
+/// read, the current time.
+static uint64_t getThreadCPUNanos() {
+#if defined(CLOCK_THREAD_CPUTIME_ID)
+  struct timespec now;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now) == 0)
+    return uint64_t(now.tv_sec) * 1000000000 + uint64_t(now.tv_nsec);
+#endif
+  return getCurrentNanos();
+}
+
+/// How long a priority level of the global queue may go unserved while
+/// it has jobs before it counts as one level higher, or 0 for no aging.
+static std::atomic<uint64_t> AgingIntervalNanos{0};
+
+/// Whether the global queue collects queue-wait statistics.
+static std::atomic<bool> CollectQueueStatistics{false};
+
+/// How many queued jobs the DropLowest policy looks through, at most, for
+/// a task to shed, so that a backlog of tasks that it has cancelled but
+/// that have not run yet does not slow down every admission.
+static constexpr size_t ShedScanLimit = 256;
+
+
+namespace {
+
+/// A batch of jobs about to be published together, linked through
+/// nextInQueue into one FIFO per priority level, as the global queue
+/// links them, so that PriorityJobQueue::append can take each level
+/// whole.  Jobs that the global queue orders by deadline or by tenant
+/// are kept apart, to be pushed one by one.  Unlike a PriorityJobQueue,
+/// this is small enough to build on the stack.
+struct JobBatch {
+  Job *Heads[NumJobPriorityLevels] = {};
+  Job *Tails[NumJobPriorityLevels] = {};
+  size_t Counts[NumJobPriorityLevels] = {};
+
+  /// Bit N is set iff Heads[N] is non-null.
+  uint32_t NonEmptyLevels = 0;
+
+  /// The jobs with a deadline or a tenant, in the order they came.
+  Job *Ordered = nullptr;
+  Job *OrderedTail = nullptr;
+
+  bool isEmpty() const {
+    return !NonEmptyLevels && !Ordered;
+  }
+
+  void push(Job *job) {
+    TaskDeadline deadline;
+    if (getSchedulingDeadline(job, deadline) || getSchedulingTenant(job)) {
+      nextInQueue(job) = nullptr;
+      if (OrderedTail)
+        nextInQueue(OrderedTail) = job;
+      else
+        Ordered = job;
+      OrderedTail = job;
       return;
     }
+    auto level = getJobPriorityLevel(job->getPriority());
+    nextInQueue(job) = nullptr;
+    if (auto tail = Tails[level]) {
+      nextInQueue(tail) = job;
+      prevInQueue(job) = tail;
+    } else {
+      Heads[level] = job;
+      prevInQueue(job) = FIFOHeadMarker;
+    }
+    Tails[level] = job;
+    ++Counts[level];
+    NonEmptyLevels |= (1u << level);
+  }
 
-    // Otherwise, keep advancing through the queue.
-    position = &nextInQueue(cur);
+  /// Remove every job, linking them through nextInQueue into a single
+  /// chain: the ordered jobs, and then the FIFO of each level from the
+  /// highest to the lowest.  Returns the first and last job of the
+  /// chain, or null if empty.
+  std::pair<Job*, Job*> takeAll() {
+    Job *first = Ordered, *last = OrderedTail;
+    for (int level = NumJobPriorityLevels - 1; level >= 0; --level) {
+      if (!Heads[level])
+        continue;
+      if (last)
+        nextInQueue(last) = Heads[level];
+      else
+        first = Heads[level];
+      last = Tails[level];
+    }
+    *this = JobBatch();
+    return {first, last};
   }
-  nextInQueue(newJob) = nullptr;
-  *position = newJob;
-}
+};
 
-/// Claim the next job from the cooperative global queue.
-static Job *claimNextFromJobQueue() {
-  if (auto job = JobQueue) {
-    JobQueue = nextInQueue(job);
+/// The cooperative global queue.
+///
+/// Jobs are kept in one intrusive FIFO per priority level, linked
+/// through nextInQueue, together with a bitmap of the levels that
+/// are non-empty.  Both insertion and claiming are O(1) regardless of
+/// how many jobs are queued, and jobs of equal priority run in the
+/// order they were enqueued.
+///
+/// When deadline scheduling is enabled, tasks that carry a deadline
+/// are instead kept in a per-level heap and run earliest deadline
+/// first, ahead of the level's FIFO jobs.
+///
+/// Tasks tagged with a tenant are kept in per-tenant FIFOs, and each
+/// level shares its turns between its tenants by deficit round robin,
+/// with the untagged FIFO as tenant 0.
+///
+/// The global queue also keeps time: it remembers when each level was
+/// last served, or became non-empty, which bounds how long the job at
+/// its head has waited.  With priority aging, a level counts as one
+/// level higher for every aging interval it has gone unserved, so a
+/// steady stream of high-priority jobs cannot starve the lower levels.
+/// This needs no per-job timestamps, so it stays O(1).
+class PriorityJobQueue {
+  /// A queued job whose task carries a deadline.
+  struct DeadlineEntry {
+    TaskDeadline Deadline;
+    uint64_t Sequence;
+    Job *QueuedJob;
+
+    /// The heap algorithms keep the greatest element on top, so the
+    /// entry that should run first must compare greatest.
+    bool operator<(const DeadlineEntry &other) const {
+      if (Deadline == other.Deadline)
+        return other.Sequence < Sequence;
+      return other.Deadline < Deadline;
+    }
+  };
+
+  struct Level {
+    Job *Head = nullptr;
+    Job *Tail = nullptr;
+
+    /// Heap of the jobs in this level that carry a deadline.
+    std::vector<DeadlineEntry> Deadlines;
+
+    /// The jobs in this level whose tasks are tagged with a tenant.
+    FairQueue Tagged;
+
+    bool isEmpty() const {
+      return !Head && Deadlines.empty() && !Tagged.hasTaggedJobs();
+    }
+
+    /// The number of jobs queued, in the FIFO and the heap.
+    size_t Count = 0;
+
+    /// When the level was last served or became non-empty, or 0 if it
+    /// has not been timed yet.
+    uint64_t ServedAt = 0;
+
+    /// When Count last changed, for accumulating the wait time.
+    uint64_t CountChangedAt = 0;
+  };
+
+  /// Statistics for a level, which other threads may read at any time.
+  struct LevelStatistics {
+    std::atomic<uint64_t> Dequeued{0};
+    std::atomic<uint64_t> AgedDequeues{0};
+    std::atomic<uint64_t> TotalWaitNanos{0};
+    std::atomic<uint64_t> MaxWaitNanos{0};
+  };
+
+  Level Levels[NumJobPriorityLevels];
+  LevelStatistics Statistics[NumJobPriorityLevels];
+
+  /// Bit N is set iff Levels[N] is non-empty.
+  uint32_t NonEmptyLevels = 0;
+
+  /// Bit N is set iff Levels[N] holds a job with a deadline.
+  uint32_t DeadlineLevels = 0;
+
+  /// Breaks ties between equal deadlines in enqueue order.
+  uint64_t NextSequence = 0;
+
+  /// The current time, if this queue needs it for aging or statistics,
+  /// or 0.
+  uint64_t getTimestamp() const {
+    if (!AgingIntervalNanos.load(std::memory_order_relaxed) &&
+        !CollectQueueStatistics.load(std::memory_order_relaxed))
+      return 0;
+    return getCurrentNanos();
+  }
+
+  static void relaxedAdd(std::atomic<uint64_t> &counter, uint64_t value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value,
+                  std::memory_order_relaxed);
+  }
+
+  /// Change a level's job count by \p delta at time \p now.  Every job
+  /// queued at the level accrues the time since the last change, so the
+  /// total is the sum of the queue waits (Little's law).
+  void adjustCount(unsigned level, ptrdiff_t delta, uint64_t now) {
+    auto &queue = Levels[level];
+    if (now) {
+      if (queue.Count && queue.CountChangedAt && now > queue.CountChangedAt &&
+          CollectQueueStatistics.load(std::memory_order_relaxed))
+        relaxedAdd(Statistics[level].TotalWaitNanos,
+                   queue.Count * (now - queue.CountChangedAt));
+      queue.CountChangedAt = now;
+      if (!queue.Count)
+        queue.ServedAt = now;
+    }
+    queue.Count += delta;
+  }
+
+  /// Note that a job was taken from \p level at time \p now.
+  void noteServed(unsigned level, bool aged, uint64_t now) {
+    auto &queue = Levels[level];
+    adjustCount(level, -1, now);
+    if (!now)
+      return;
+    if (CollectQueueStatistics.load(std::memory_order_relaxed)) {
+      auto &stats = Statistics[level];
+      relaxedAdd(stats.Dequeued, 1);
+      if (aged)
+        relaxedAdd(stats.AgedDequeues, 1);
+      if (queue.ServedAt && now > queue.ServedAt &&
+          now - queue.ServedAt > stats.MaxWaitNanos.load(
+                                     std::memory_order_relaxed))
+        stats.MaxWaitNanos.store(now - queue.ServedAt,
+                                 std::memory_order_relaxed);
+    }
+    queue.ServedAt = now;
+  }
+
+  /// How many levels a level has risen by having gone unserved.
+  uint64_t getAge(unsigned level, uint64_t now, uint64_t interval) {
+    auto &queue = Levels[level];
+    if (!queue.ServedAt) {
+      // Aging was just turned on; start timing the level now.
+      queue.ServedAt = now;
+      return 0;
+    }
+    return now > queue.ServedAt ? (now - queue.ServedAt) / interval : 0;
+  }
+
+  /// Choose the level to serve next among \p allowedLevels, which must
+  /// include a non-empty one: the one with the highest level plus age,
+  /// preferring the higher level on ties.  Sets \p aged if that is not
+  /// the highest allowed non-empty level.
+  unsigned chooseLevel(uint64_t now, uint32_t allowedLevels, bool &aged) {
+    auto candidates = NonEmptyLevels & allowedLevels;
+    auto highest = llvm::findLastSet(candidates, llvm::ZB_Undefined);
+    aged = false;
+    auto interval = AgingIntervalNanos.load(std::memory_order_relaxed);
+    if (!interval || !now)
+      return highest;
+
+    auto best = highest;
+    auto bestRank = highest + getAge(highest, now, interval);
+    auto levels = candidates & ~(1u << highest);
+    while (levels) {
+      auto level = llvm::findLastSet(levels, llvm::ZB_Undefined);
+      levels &= ~(1u << level);
+      auto rank = level + getAge(level, now, interval);
+      if (rank > bestRank) {
+        best = level;
+        bestRank = rank;
+      }
+    }
+    aged = best != highest;
+    return best;
+  }
+
+  void pushFIFO(Job *job, unsigned level) {
+    auto &queue = Levels[level];
+    nextInQueue(job) = nullptr;
+    if (queue.Tail) {
+      nextInQueue(queue.Tail) = job;
+      prevInQueue(job) = queue.Tail;
+    } else {
+      queue.Head = job;
+      prevInQueue(job) = FIFOHeadMarker;
+    }
+    setQueuedInFIFO(job, true);
+    queue.Tail = job;
+    NonEmptyLevels |= (1u << level);
+  }
+
+  /// Remove a job from the middle of its level's FIFO.
+  void unlinkFIFO(Job *job, unsigned level) {
+    auto &queue = Levels[level];
+    auto prev = prevInQueue(job);
+    auto next = nextInQueue(job);
+    if (prev == FIFOHeadMarker)
+      queue.Head = next;
+    else
+      nextInQueue(prev) = next;
+    if (next)
+      prevInQueue(next) = prev;
+    else
+      queue.Tail = prev == FIFOHeadMarker ? nullptr : prev;
+    setQueuedInFIFO(job, false);
+    if (queue.isEmpty())
+      NonEmptyLevels &= ~(1u << level);
+  }
+
+  void pushWithDeadline(Job *job, TaskDeadline deadline, unsigned level) {
+    auto &heap = Levels[level].Deadlines;
+    heap.push_back({deadline, NextSequence++, job});
+    std::push_heap(heap.begin(), heap.end());
+    NonEmptyLevels |= (1u << level);
+    DeadlineLevels |= (1u << level);
+  }
+
+public:
+  void push(Job *job) {
+    auto level = getJobPriorityLevel(job->getPriority());
+    adjustCount(level, 1, getTimestamp());
+    TaskDeadline deadline;
+    if (getSchedulingDeadline(job, deadline)) {
+      pushWithDeadline(job, deadline, level);
+    } else if (auto tenant = getSchedulingTenant(job)) {
+      Levels[level].Tagged.push(job, tenant);
+      NonEmptyLevels |= (1u << level);
+    } else {
+      pushFIFO(job, level);
+    }
+  }
+
+  /// The time at or after which the longest-unserved non-empty level
+  /// was last served, or UINT64_MAX if the queue is empty or not timed.
+  uint64_t getOldestServedAt() const {
+    uint64_t oldest = UINT64_MAX;
+    auto levels = NonEmptyLevels;
+    while (levels) {
+      auto level = llvm::findLastSet(levels, llvm::ZB_Undefined);
+      levels &= ~(1u << level);
+      if (Levels[level].ServedAt)
+        oldest = std::min(oldest, Levels[level].ServedAt);
+    }
+    return oldest;
+  }
+
+  QueueWaitStatistics getStatistics(unsigned level) const {
+    auto &stats = Statistics[level];
+    QueueWaitStatistics result;
+    result.Dequeued = stats.Dequeued.load(std::memory_order_relaxed);
+    result.AgedDequeues = stats.AgedDequeues.load(std::memory_order_relaxed);
+    result.TotalWaitNanos =
+      stats.TotalWaitNanos.load(std::memory_order_relaxed);
+    result.MaxWaitNanos = stats.MaxWaitNanos.load(std::memory_order_relaxed);
+    return result;
+  }
+
+  void resetStatistics() {
+    for (auto &stats : Statistics) {
+      stats.Dequeued.store(0, std::memory_order_relaxed);
+      stats.AgedDequeues.store(0, std::memory_order_relaxed);
+      stats.TotalWaitNanos.store(0, std::memory_order_relaxed);
+      stats.MaxWaitNanos.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  /// Return a bitmap with bit N set iff a job of priority level N
+  /// is queued.
+  uint32_t getNonEmptyLevels() const {
+    return NonEmptyLevels;
+  }
+
+  /// Return a bitmap with bit N set iff a job of priority level N
+  /// with a deadline is queued.
+  uint32_t getDeadlineLevels() const {
+    return DeadlineLevels;
+  }
+
+  /// Return a bitmap with bit N set iff a job of priority level N
+  /// tagged with a tenant is queued.
+  uint32_t getTenantLevels() const {
+    uint32_t levels = 0;
+    for (unsigned i = 0; i < NumJobPriorityLevels; ++i)
+      if (Levels[i].Tagged.hasTaggedJobs())
+        levels |= 1u << i;
+    return levels;
+  }
+
+  /// Move every job from \p batch to the back of the matching level of
+  /// this queue.  Each level is linked in whole, but its jobs are only
+  /// marked queued here, under the queue's owner, so that a thread that
+  /// escalates one of them meanwhile does not trust its back-pointer.
+  void append(JobBatch &batch) {
+    auto now = getTimestamp();
+    auto levels = batch.NonEmptyLevels;
+    while (levels) {
+      auto level = llvm::findLastSet(levels, llvm::ZB_Undefined);
+      levels &= ~(1u << level);
+      auto &to = Levels[level];
+      adjustCount(level, ptrdiff_t(batch.Counts[level]), now);
+      if (to.Tail) {
+        nextInQueue(to.Tail) = batch.Heads[level];
+        prevInQueue(batch.Heads[level]) = to.Tail;
+      } else {
+        to.Head = batch.Heads[level];
+      }
+      for (auto job = batch.Heads[level]; job; job = nextInQueue(job))
+        setQueuedInFIFO(job, true);
+      to.Tail = batch.Tails[level];
+      NonEmptyLevels |= (1u << level);
+    }
+    for (auto job = batch.Ordered; job; ) {
+      auto next = nextInQueue(job);
+      push(job);
+      job = next;
+    }
+    batch = JobBatch();
+  }
+
+  /// Take the job at the front of a level's FIFO.
+  static Job *popFIFO(Level &queue) {
+    auto job = queue.Head;
+    queue.Head = nextInQueue(job);
+    if (queue.Head)
+      prevInQueue(queue.Head) = FIFOHeadMarker;
+    else
+      queue.Tail = nullptr;
+    setQueuedInFIFO(job, false);
     return job;
   }
-  return nullptr;
+
+  /// Take the next job from one of \p allowedLevels, a bitmap of
+  /// priority levels.  If tenants had to share its level, \p tenant is
+  /// set to the tenant whose turn it was, which should be charged for
+  /// running the job; otherwise it is set to MaxTenants.
+  Job *pop(unsigned &tenant, uint32_t allowedLevels = AllJobPriorityLevels) {
+    tenant = MaxTenants;
+    if (!(NonEmptyLevels & allowedLevels))
+      return nullptr;
+
+    auto now = getTimestamp();
+    bool aged;
+    auto level = chooseLevel(now, allowedLevels, aged);
+    noteServed(level, aged, now);
+    auto &queue = Levels[level];
+    Job *job;
+    if (DeadlineLevels & (1u << level)) {
+      auto &heap = queue.Deadlines;
+      std::pop_heap(heap.begin(), heap.end());
+      job = heap.back().QueuedJob;
+      heap.pop_back();
+      if (heap.empty())
+        DeadlineLevels &= ~(1u << level);
+    } else if (queue.Tagged.hasTaggedJobs()) {
+      queue.Tagged.setUntaggedBacklogged(queue.Head != nullptr, Tenants);
+      tenant = queue.Tagged.chooseTenant(Tenants);
+      if (tenant) {
+        job = queue.Tagged.take(tenant, Tenants);
+      } else {
+        job = popFIFO(queue);
+        if (!queue.Head)
+          queue.Tagged.setUntaggedBacklogged(false, Tenants);
+      }
+    } else {
+      queue.Tagged.setUntaggedBacklogged(false, Tenants);
+      job = popFIFO(queue);
+    }
+    if (queue.isEmpty())
+      NonEmptyLevels &= ~(1u << level);
+    return job;
+  }
+
+  Job *pop() {
+    unsigned tenant;
+    return pop(tenant);
+  }
+
+  /// If \p job is waiting in one of the FIFOs and \p newPriority maps to
+  /// a higher level, move it to the back of that level's FIFO and raise
+  /// its priority.  This is O(1).  Returns whether the job moved.
+  ///
+  /// Jobs with a deadline or a tenant stay where they are, and so do jobs
+  /// that are not in this queue at all, e.g. in a NextJob slot, a
+  /// worker's deque or inbox, or the injection queue.
+  bool escalate(Job *job, JobPriority newPriority) {
+    if (!isQueuedInFIFO(job))
+      return false;
+    auto level = getJobPriorityLevel(job->getPriority());
+    auto newLevel = getJobPriorityLevel(newPriority);
+    if (newLevel <= level)
+      return false;
+
+    auto now = getTimestamp();
+    unlinkFIFO(job, level);
+    adjustCount(level, -1, now);
+    job->Flags.setPriority(newPriority);
+    adjustCount(newLevel, 1, now);
+    pushFIFO(job, newLevel);
+    return true;
+  }
+
+  /// Find a task that is not cancelled yet in the FIFOs of the levels
+  /// below \p level, the lowest level first and the oldest task first
+  /// within a level.  Returns null if there is none among the first
+  /// ShedScanLimit jobs.
+  AsyncTask *findUncancelledTaskBelow(unsigned level) {
+    size_t scanned = 0;
+    for (unsigned lower = 0; lower < level; ++lower) {
+      for (auto job = Levels[lower].Head; job; job = nextInQueue(job)) {
+        if (++scanned > ShedScanLimit)
+          return nullptr;
+        auto task = dyn_cast<AsyncTask>(job);
+        if (task && !task->isCancelled())
+          return task;
+      }
+    }
+    return nullptr;
+  }
+};
+
+/// A group of workers reserved for the jobs of one WorkerBand.
+struct WorkerBandState {
+  WorkerBand Band;
+
+  /// Whether the band's threads should try to run under SCHED_FIFO.
+  bool IsRealtime = false;
+
+  /// The priority levels whose jobs the band runs, as a bitmap.
+  uint32_t Levels;
+
+  /// Where the band's workers wait when they run out of jobs, so that
+  /// publishing a job wakes a worker that can run it.
+  ThreadParker IdleThreads;
+};
+
+/// A share of the global executor's queue depth, by priority level.
+/// See SharedQueueDepth.
+struct QueueDepthShard {
+  std::atomic<intptr_t> Depths[NumJobPriorityLevels] = {};
+};
+
+/// A thread of the global executor's worker pool.
+struct WorkerThread {
+  /// Jobs enqueued while running on this worker, one deque per
+  /// priority level.
+  WorkStealingDeque LocalQueues[NumJobPriorityLevels];
+
+  /// Jobs that other threads directed at this worker with
+  /// enqueueGlobalOnWorker, and how many there are.  The worker moves
+  /// them to its deques when it next claims a job; until then, idle
+  /// workers that can run them may steal them.  InboxLock guards the
+  /// consuming side.
+  InjectionQueue Inbox;
+  std::atomic<size_t> InboxDepth{0};
+  std::mutex InboxLock;
+
+  /// The band that the worker belongs to, or null if the pool has no
+  /// bands and every worker runs every job.
+  WorkerBandState *Band = nullptr;
+
+  /// The index in WorkerPool::Nodes of the NUMA node that the worker is
+  /// pinned to.
+  unsigned Node = 0;
+
+  /// State for choosing steal victims.
+  uint32_t RandomState;
+
+  /// The worker's share of the queue depth, which only it changes.
+  QueueDepthShard QueueDepth;
+
+  /// The worker's NextJob slot, in place of its thread's own, so that
+  /// the watcher can publish a job that waits there behind a long job.
+  std::atomic<Job*> NextJobSlot{nullptr};
+
+  /// How many jobs the worker has started, which only it changes.
+  std::atomic<size_t> JobsStarted{0};
+
+  /// What the watcher saw in NextJobSlot and JobsStarted when it last
+  /// parked.  See publishStalledNextJobs.
+  Job *SeenNextJob = nullptr;
+  size_t SeenJobsStarted = 0;
+
+  /// Return the highest priority level with a job in the local deques,
+  /// or -1 if they are all empty.
+  int getHighestLocalLevel() const {
+    for (int level = NumJobPriorityLevels - 1; level >= 0; --level)
+      if (!LocalQueues[level].isEmpty())
+        return level;
+    return -1;
+  }
+
+  uint32_t nextRandom() {
+    // xorshift32
+    RandomState ^= RandomState << 13;
+    RandomState ^= RandomState >> 17;
+    RandomState ^= RandomState << 5;
+    return RandomState;
+  }
+};
+
+/// State shared by the threads of the worker pool.  It is allocated
+/// when the pool starts and deliberately never destroyed: the workers
+/// are detached and keep using it while the process exits.
+struct WorkerPool {
+  WorkerThread *Workers;
+  unsigned NumWorkers;
+
+  /// The bands, if the pool was started with startGlobalExecutorBands,
+  /// and the band of each priority level.
+  WorkerBandState *Bands = nullptr;
+  unsigned NumBands = 0;
+  WorkerBandState *LevelBands[NumJobPriorityLevels] = {};
+
+  /// The NUMA nodes that the workers are pinned to, if NUMA placement is
+  /// enabled and the process may run on more than one node.
+  std::vector<NUMANode> Nodes;
+
+  /// Guards JobQueue and the consuming side of ForeignJobQueue.
+  std::mutex GlobalQueueLock;
+};
+
+/// A job that calls a C function and then frees itself.
+class CallbackJob : public Job {
+  void (*Callback)(void *);
+  void *Context;
+
+  SWIFT_CC(swiftasync)
+  static void process(Job *job, ExecutorRef executor) {
+    auto self = static_cast<CallbackJob*>(job);
+    auto callback = self->Callback;
+    auto context = self->Context;
+    delete self;
+    callback(context);
+  }
+
+public:
+  /// The private job kind used for callback jobs.
+  static constexpr JobKind Kind = getJobKind(LibraryJobKind::Callback);
+
+  CallbackJob(JobPriority priority, void (*callback)(void *), void *context)
+    : Job(JobFlags(Kind, priority), &process),
+      Callback(callback), Context(context) {}
+};
+
+/// A job that performs an I/O operation and then calls a C function
+/// with its result.
+///
+/// With io_uring, the job is the operation's user data and is enqueued
+/// once the operation completes.  Without it, the job waits for the
+/// descriptor to become ready and performs the operation when it runs,
+/// or has a thread of the blocking pool perform it.
+class IOJob : public Job {
+  SWIFT_CC(swiftasync)
+  static void process(Job *job, ExecutorRef executor);
+
+  /// Perform the operation on the current thread.  Returns the same
+  /// result that io_uring would: a count or descriptor, or -errno.
+  int32_t performInline();
+
+public:
+  /// Perform the operation on a thread of the blocking pool and then
+  /// enqueue the job to report the result.
+  void performOnBlockingPool();
+
+  IOOperation Operation;
+  bool IsComplete = false;
+  int FD;
+  void *Buffer;
+  uint32_t Length;
+  uint64_t Offset;
+  int32_t Result = 0;
+  void (*Callback)(void *, int32_t);
+  void *Context;
+
+  IOJob(JobPriority priority, IOOperation operation, int fd, void *buffer,
+        uint32_t length, uint64_t offset, void (*callback)(void *, int32_t),
+        void *context)
+    : Job(JobFlags(CallbackJob::Kind, priority), &process),
+      Operation(operation), FD(fd), Buffer(buffer), Length(length),
+      Offset(offset), Callback(callback), Context(context) {}
+
+  bool isWrite() const { return Operation == IOOperation::Write; }
+};
+
+/// Timer ticks are 2^20 nanoseconds, a little over a millisecond.
+enum : unsigned { TimerTickShift = 20 };
+
+/// How many jobs a thread runs between checks for expired timers, ready
+/// file descriptors and I/O completions, and between I/O submissions.
+enum : unsigned { EventCheckInterval = 64 };
+
+/// Jobs that were enqueued with a delay and have not come due yet.
+struct TimerState {
+  std::mutex Lock;
+  TimerWheel Wheel{getCurrentNanos() >> TimerTickShift};
+};
+
+} // end anonymous namespace
+
+/// The default cap on the threads of the blocking pool, and how long
+/// they stay idle before exiting.
+enum : unsigned { DefaultMaxBlockingThreads = 64 };
+static constexpr uint64_t DefaultBlockingIdleNanos = 10000000000;
+
+/// The threads that run blocking work.  It is never destroyed, since its
+/// threads are detached.
+static BlockingPool &BlockingThreads =
+  *new BlockingPool(DefaultMaxBlockingThreads, DefaultBlockingIdleNanos);
+
+void my_swift::runBlocking(void (*work)(void *), void *context) {
+  BlockingThreads.run(work, context);
 }
 
-void my_swift::donateThreadToGlobalExecutorUntil(bool (*condition)(void *),
-                                              void *conditionContext) {
-  while (!condition(conditionContext)) {
-    auto job = claimNextFromJobQueue();
-    if (!job) return;
-    job->run(ExecutorRef::generic());
+void my_swift::setBlockingPoolLimits(unsigned maxThreads,
+                                     uint64_t idleTimeoutNanos) {
+  BlockingThreads.setLimits(maxThreads, idleTimeoutNanos);
+}
+
+/// The global queue.  It is never destroyed, since detached worker
+/// threads may still be using it while the process exits.
+static PriorityJobQueue &JobQueue = *new PriorityJobQueue();
+static InjectionQueue ForeignJobQueue;
+
+/// Whether the current thread is draining the cooperative global queue.
+/// Only that thread may touch JobQueue directly.
+static SWIFT_RUNTIME_DECLARE_THREAD_LOCAL(bool, IsDrainingThread);
+
+/// Whether the global executor runs on a pool of worker threads rather
+/// than on a single donated thread.  This is decided once, before any
+/// job is enqueued.
+static bool UseWorkerPool = false;
+
+/// Whether the global executor hands its jobs to libdispatch instead.
+/// This is decided the same way.
+static bool UseDispatch = false;
+
+static WorkerPool *Pool = nullptr;
+
+/// The worker pool thread that is running on the current thread, if any.
+static SWIFT_RUNTIME_DECLARE_THREAD_LOCAL(WorkerThread *, CurrentWorker);
+
+/// Copies of JobQueue's level bitmaps that can be read without taking
+/// the pool's GlobalQueueLock.
+static std::atomic<uint32_t> GlobalNonEmptyLevels{0};
+static std::atomic<uint32_t> GlobalDeadlineLevels{0};
+static std::atomic<uint32_t> GlobalTenantLevels{0};
+
+/// JobQueue.getOldestServedAt(), for deciding without the lock whether
+/// a level of the global queue has aged enough to run ahead of local jobs.
+static std::atomic<uint64_t> GlobalOldestServedAt{UINT64_MAX};
+
+/// Update the copies of JobQueue's level bitmaps after changing it.
+/// The caller must hold GlobalQueueLock.
+static void publishGlobalLevels();
+
+/// Whether \p job must go through the global queue, where it is
+/// ordered by deadline or shared fairly with other tenants, rather than
+/// a thread's NextJob slot or a worker's local deque.  That is the case
+/// for a job whose task carries a deadline or is tagged with a tenant,
+/// and for an untagged job while tagged jobs are queued at its level,
+/// since it then competes with them as tenant 0 and would otherwise run
+/// ahead of its share.  Only the draining thread may call this in
+/// cooperative mode.
+static bool needsGlobalOrdering(Job *job) {
+  if (UseTenantScheduling.load(std::memory_order_relaxed)) {
+    if (getSchedulingTenant(job) != 0)
+      return true;
+    auto tenantLevels =
+      UseWorkerPool ? GlobalTenantLevels.load(std::memory_order_acquire)
+                    : JobQueue.getTenantLevels();
+    if (tenantLevels & (1u << getJobPriorityLevel(job->getPriority())))
+      return true;
+  }
+  TaskDeadline deadline;
+  return getSchedulingDeadline(job, deadline);
+}
+
+/// Where threads of the global executor wait when they run out of jobs.
+static ThreadParker IdleThreads;
+
+/// The timer wheel.  Like JobQueue, it is never destroyed.
+static TimerState &Timers = *new TimerState();
+
+/// The tick at which the timer wheel next needs attention, or UINT64_MAX
+/// if it is empty.  This can be read without taking Timers.Lock.
+static std::atomic<uint64_t> NextTimerTick{UINT64_MAX};
+
+/// The reactor for jobs waiting on file descriptors, once one of them
+/// has asked for it.  It is never destroyed.
+static std::atomic<Reactor*> IOReactor{nullptr};
+
+/// Whether some idle thread is already waiting for the next timer and
+/// for I/O events.  The other idle threads sleep until they are unparked.
+static std::atomic<bool> HasWatcher{false};
+
+/// The descriptors through which an event loop that runs the executor
+/// with runGlobalExecutorFor learns that there is work for it.
+struct HostWakeup {
+  /// An epoll set of EventFD and the reactor's descriptor, for the event
+  /// loop to wait on.
+  int EpollFD = -1;
+
+  /// Written when work is published while IsArmed.
+  int EventFD = -1;
+
+  /// Whether the event loop may be waiting for EventFD.  It is armed
+  /// when runGlobalExecutorFor returns, and disarmed by the first write.
+  std::atomic<bool> IsArmed{false};
+};
+
+/// The host wakeup, once the event loop has asked for its descriptor.
+/// It is never destroyed.
+static std::atomic<HostWakeup*> Host{nullptr};
+
+/// Make the host wakeup descriptor readable if the event loop may be
+/// waiting on it.
+static void notifyHost() {
+#if defined(__linux__)
+  auto host = Host.load(std::memory_order_acquire);
+  if (!host)
+    return;
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (host->IsArmed.load(std::memory_order_relaxed) &&
+      host->IsArmed.exchange(false, std::memory_order_relaxed)) {
+    uint64_t one = 1;
+    (void)write(host->EventFD, &one, sizeof(one));
+  }
+#endif
+}
+
+/// The priority levels whose jobs \p worker runs, as a bitmap.  A thread
+/// that is not a worker, such as a donated one, runs them all.
+static uint32_t getWorkerLevels(WorkerThread *worker) {
+  return worker && worker->Band ? worker->Band->Levels : AllJobPriorityLevels;
+}
+
+/// Where \p worker, or a thread that is not a worker, parks when idle.
+static ThreadParker &getIdleThreads(WorkerThread *worker) {
+  return worker && worker->Band ? worker->Band->IdleThreads : IdleThreads;
+}
+
+/// The wake mask with which \p worker parks, for enqueueGlobalOnWorker
+/// to wake it rather than another idle thread.  Workers share the first
+/// 31 bits and every other thread has the last, so that waking a worker
+/// never wakes a donated thread.
+static uint32_t getWakeMask(WorkerThread *worker) {
+  if (!worker)
+    return 1u << 31;
+  return 1u << (unsigned(worker - Pool->Workers) % 31);
+}
+
+/// Where the workers that run jobs of priority level \p level park.
+static ThreadParker &getIdleThreadsForLevel(unsigned level) {
+  if (Pool && Pool->NumBands)
+    return Pool->LevelBands[level]->IdleThreads;
+  return IdleThreads;
+}
+
+/// Wake the thread blocked in the reactor, if any, and the event loop
+/// running the executor, if it is waiting, after publishing work.
+static void interruptEventWaiters() {
+  if (auto reactor = IOReactor.load(std::memory_order_acquire))
+    reactor->interrupt();
+  notifyHost();
+}
+
+/// Wake up to \p count parked threads of every band.
+static void unparkEveryBand(unsigned count) {
+  IdleThreads.unparkMany(count);
+  if (Pool)
+    for (unsigned band = 0; band < Pool->NumBands; ++band)
+      Pool->Bands[band].IdleThreads.unparkMany(count);
+}
+
+/// Wake up to \p count parked threads after publishing work, the thread
+/// blocked in the reactor, if any, and the event loop running the
+/// executor, if it is waiting.
+static void unparkIdleThreads(unsigned count) {
+  unparkEveryBand(count);
+  interruptEventWaiters();
+}
+
+/// Wake up to \p count parked threads that can run jobs of priority
+/// level \p level, after publishing such jobs, and the event waiters.
+static void unparkIdleThreadsForLevel(unsigned level, unsigned count) {
+  getIdleThreadsForLevel(level).unparkMany(count);
+  interruptEventWaiters();
+}
+
+/// The number of jobs at each priority level that have been enqueued on
+/// the global executor and have not started running yet, wherever they
+/// are queued, is the sum of several shards, so that threads do not all
+/// write one cache line for every job.  Jobs waiting on a timer or for
+/// I/O do not count.  Each worker counts the jobs it enqueues and runs
+/// in a shard of its own, with plain stores, and the other threads count
+/// theirs here, with atomic read-modify-writes.  A job is often counted
+/// in one shard and uncounted in another, so a shard may go negative;
+/// only the sum means anything.
+static QueueDepthShard SharedQueueDepth;
+
+/// The admission policy, as an AdmissionPolicy, and its high-water mark.
+static std::atomic<uint8_t> CurrentAdmissionPolicy{
+  uint8_t(AdmissionPolicy::None)};
+static std::atomic<size_t> HighWaterMark{SIZE_MAX};
+
+/// Callbacks waiting for the queue to drain below the low-water mark.
+struct AdmissionWaitList {
+  std::mutex Lock;
+  std::vector<std::pair<void (*)(void *), void *>> Waiters;
+};
+
+/// Never destroyed, since detached threads may still be using it while
+/// the process exits.
+static AdmissionWaitList &AdmissionWaiters = *new AdmissionWaitList();
+static std::atomic<bool> HasAdmissionWaiters{false};
+
+static void adjustQueueDepth(unsigned level, intptr_t delta) {
+  if (auto worker = CurrentWorker.get()) {
+    auto &depth = worker->QueueDepth.Depths[level];
+    depth.store(depth.load(std::memory_order_relaxed) + delta,
+                std::memory_order_relaxed);
+  } else {
+    SharedQueueDepth.Depths[level].fetch_add(delta,
+                                             std::memory_order_relaxed);
+  }
+}
+
+static size_t getQueueDepth(unsigned level) {
+  auto depth = SharedQueueDepth.Depths[level].load(std::memory_order_relaxed);
+  if (Pool)
+    for (unsigned i = 0; i < Pool->NumWorkers; ++i)
+      depth += Pool->Workers[i].QueueDepth.Depths[level].load(
+          std::memory_order_relaxed);
+  return depth > 0 ? size_t(depth) : 0;
+}
+
+static size_t getTotalQueueDepth() {
+  size_t depth = 0;
+  for (unsigned level = 0; level < NumJobPriorityLevels; ++level)
+    depth += getQueueDepth(level);
+  return depth;
+}
+
+/// Backpressured work resumes once the queue is below half the
+/// high-water mark, so that it does not resume and stall one job at a
+/// time right at the mark.
+static size_t getLowWaterMark() {
+  return HighWaterMark.load(std::memory_order_relaxed) / 2;
+}
+
+static bool isOverHighWaterMark() {
+  return getTotalQueueDepth() >= HighWaterMark.load(std::memory_order_relaxed);
+}
+
+/// Count \p job as queued.
+static void noteJobQueued(Job *job) {
+  adjustQueueDepth(getJobPriorityLevel(job->getPriority()), 1);
+}
+
+/// Resume the work that is waiting for admission, if the queue has
+/// drained enough.
+static void resumeAdmissionWaiters() {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (getTotalQueueDepth() > getLowWaterMark())
+    return;
+  std::vector<std::pair<void (*)(void *), void *>> waiters;
+  {
+    std::lock_guard<std::mutex> guard(AdmissionWaiters.Lock);
+    waiters.swap(AdmissionWaiters.Waiters);
+    HasAdmissionWaiters.store(false, std::memory_order_relaxed);
+  }
+  for (auto &waiter : waiters)
+    waiter.first(waiter.second);
+}
+
+/// Count a job of priority level \p level as no longer queued.
+static void noteJobDequeued(unsigned level) {
+  adjustQueueDepth(level, -1);
+  // Only backpressure leaves work waiting, and setGlobalAdmissionPolicy
+  // resumes it when the policy changes.
+  if (AdmissionPolicy(CurrentAdmissionPolicy.load(
+          std::memory_order_relaxed)) != AdmissionPolicy::Backpressure)
+    return;
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (HasAdmissionWaiters.load(std::memory_order_relaxed))
+    resumeAdmissionWaiters();
+}
+
+void my_swift::setGlobalAdmissionPolicy(AdmissionPolicy policy,
+                                        size_t highWaterMark) {
+  HighWaterMark.store(policy == AdmissionPolicy::None ? SIZE_MAX
+                                                      : highWaterMark,
+                      std::memory_order_relaxed);
+  CurrentAdmissionPolicy.store(uint8_t(policy), std::memory_order_relaxed);
+  if (HasAdmissionWaiters.load(std::memory_order_relaxed))
+    resumeAdmissionWaiters();
+}
+
+size_t my_swift::getGlobalQueueDepth() {
+  return getTotalQueueDepth();
+}
+
+size_t my_swift::getGlobalQueueDepth(JobPriority priority) {
+  return getQueueDepth(getJobPriorityLevel(priority));
+}
+
+static bool cancelQueuedTaskBelow(unsigned level);
+
+AdmissionResult my_swift::admitGlobalWork(JobPriority priority,
+                                          void (*resume)(void *),
+                                          void *context) {
+  switch (AdmissionPolicy(
+      CurrentAdmissionPolicy.load(std::memory_order_relaxed))) {
+  case AdmissionPolicy::None:
+    return AdmissionResult::Admitted;
+  case AdmissionPolicy::DropLowest:
+    // New work only goes over the mark in exchange for a queued task of
+    // lower priority; otherwise it is the lowest, and is dropped.
+    if (!isOverHighWaterMark() ||
+        cancelQueuedTaskBelow(getJobPriorityLevel(priority)))
+      return AdmissionResult::Admitted;
+    return AdmissionResult::Rejected;
+  case AdmissionPolicy::Reject:
+    return isOverHighWaterMark() ? AdmissionResult::Rejected
+                                 : AdmissionResult::Admitted;
+  case AdmissionPolicy::Backpressure:
+    if (!isOverHighWaterMark())
+      return AdmissionResult::Admitted;
+    {
+      std::lock_guard<std::mutex> guard(AdmissionWaiters.Lock);
+      AdmissionWaiters.Waiters.emplace_back(resume, context);
+      HasAdmissionWaiters.store(true, std::memory_order_seq_cst);
+    }
+    // The queue may have drained before we were on the list.
+    resumeAdmissionWaiters();
+    return AdmissionResult::Deferred;
+  }
+  return AdmissionResult::Admitted;
+}
+
+static void enqueueOnWorkerPool(Job *job);
+static void enqueueBatchOnWorkerPool(Job **jobs, size_t count);
+
+/// A job that the job running on this thread enqueued, which this
+/// thread runs next, ahead of the queues.  When one task wakes another,
+/// as in request/response chains, the woken task then runs right away
+/// and finds the data it was handed still in cache.  A worker keeps the
+/// job in its WorkerThread::NextJobSlot instead.
+static SWIFT_RUNTIME_DECLARE_THREAD_LOCAL(Job *, NextJob);
+
+/// How many jobs in a row this thread has taken from NextJob.
+static SWIFT_RUNTIME_DECLARE_THREAD_LOCAL(uintptr_t, NextJobRunLength);
+
+/// After this many jobs in a row from NextJob, the next one goes to the
+/// back of the queue instead, so that two tasks that keep waking each
+/// other cannot starve everything else.
+enum : unsigned { MaxNextJobRunLength = 3 };
+
+/// How long a job may wait in a worker's NextJob slot while the worker
+/// runs the same job before the watcher moves it to the global queue.
+enum : uint64_t { NextJobStallNanos = 1000000 };
+
+/// Put \p job in the current thread's NextJob slot, or its worker's if
+/// it is one, and return the job that was there.
+static Job *exchangeNextJob(Job *job) {
+  if (auto worker = CurrentWorker.get())
+    return worker->NextJobSlot.exchange(job, std::memory_order_acq_rel);
+  auto previous = NextJob.get();
+  NextJob.set(job);
+  return previous;
+}
+
+static bool hasNextJob() {
+  if (auto worker = CurrentWorker.get())
+    return worker->NextJobSlot.load(std::memory_order_relaxed);
+  return NextJob.get();
+}
+
+static void ensureNextJobsWatched();
+
+/// Is the current thread running jobs for the global executor?
+static bool isExecutorThread() {
+  return IsDrainingThread.get() || CurrentWorker.get();
+}
+
+bool my_swift::isGlobalExecutorThread() {
+  return isExecutorThread();
+}
+
+/// The job that the global executor is running on this thread, if any.
+static SWIFT_RUNTIME_DECLARE_THREAD_LOCAL(Job *, RunningJob);
+
+/// One more than the tenant to charge for the next job this thread runs,
+/// or 0 if none, and what it has been charged already.
+static SWIFT_RUNTIME_DECLARE_THREAD_LOCAL(uintptr_t, ChargedTenant);
+static SWIFT_RUNTIME_DECLARE_THREAD_LOCAL(intptr_t, ChargedEstimate);
+
+/// Charge \p tenant, as set by PriorityJobQueue::pop, for the job that
+/// this thread claimed and is about to run.
+static void chargeTenantForNextJob(unsigned tenant) {
+  if (tenant == MaxTenants)
+    return;
+  ChargedEstimate.set(intptr_t(Tenants.chargeEstimate(tenant)));
+  ChargedTenant.set(tenant + 1);
+}
+
+static void runJob(Job *job) {
+  noteJobDequeued(getJobPriorityLevel(job->getPriority()));
+  auto previous = RunningJob.get();
+  RunningJob.set(job);
+  if (auto charged = ChargedTenant.get()) {
+    ChargedTenant.set(0);
+    auto start = getThreadCPUNanos();
+    job->run(ExecutorRef::generic());
+    Tenants.settle(unsigned(charged - 1), ChargedEstimate.get(),
+                   int64_t(getThreadCPUNanos() - start));
+  } else {
+    job->run(ExecutorRef::generic());
+  }
+  RunningJob.set(previous);
+}
+
+#if SWIFT_CONCURRENCY_ENABLE_DISPATCH
+/// The global concurrent queue of each priority level, in Dispatch mode.
+static dispatch_queue_t DispatchQueues[NumJobPriorityLevels];
+
+static void runDispatchedJob(void *job) {
+  runJob(static_cast<Job*>(job));
+}
+#endif
+
+/// Hand a job to the Dispatch queue of its priority level.
+static void enqueueOnDispatch(Job *job) {
+#if SWIFT_CONCURRENCY_ENABLE_DISPATCH
+  dispatch_async_f(DispatchQueues[getJobPriorityLevel(job->getPriority())],
+                   job, runDispatchedJob);
+#else
+  swift_unreachable("global executor built without Dispatch");
+#endif
+}
+
+/// Put a job on the queues, bypassing NextJob.
+static void enqueueOnQueues(Job *job) {
+  if (UseDispatch)
+    enqueueOnDispatch(job);
+  else if (UseWorkerPool)
+    enqueueOnWorkerPool(job);
+  else if (IsDrainingThread.get())
+    JobQueue.push(job);
+  else {
+    ForeignJobQueue.push(job);
+    unparkIdleThreads(1);
+  }
+}
+
+/// Insert a job into the global queue.  This can be called from any
+/// thread.  In cooperative mode, jobs enqueued from other threads than
+/// the draining one go through the injection queue.
+///
+/// A job enqueued by a job running on an executor thread goes into that
+/// thread's NextJob slot instead, pushing out the job that was there.
+/// Jobs that must be ordered by deadline or tenant always go on the
+/// queues, and so do jobs that belong to another worker band.
+void insertIntoJobQueue(Job *newJob) {
+  noteJobQueued(newJob);
+  if (isExecutorThread() && !needsGlobalOrdering(newJob) &&
+      (getWorkerLevels(CurrentWorker.get()) &
+       (1u << getJobPriorityLevel(newJob->getPriority())))) {
+    auto previous = exchangeNextJob(newJob);
+    if (!previous) {
+      if (CurrentWorker.get())
+        ensureNextJobsWatched();
+      return;
+    }
+    newJob = previous;
+  }
+  enqueueOnQueues(newJob);
+}
+
+/// Take the job in this thread's NextJob slot, if it is allowed to run
+/// before the queued jobs: it must not have run too many jobs from the
+/// slot in a row, and no queued job may have a higher priority level
+/// than \p highestQueuedLevel.  Otherwise the job goes on the queues.
+static Job *takeNextJob(int highestQueuedLevel) {
+  auto job = exchangeNextJob(nullptr);
+  if (!job)
+    return nullptr;
+
+  auto runLength = NextJobRunLength.get();
+  if (runLength < MaxNextJobRunLength &&
+      int(getJobPriorityLevel(job->getPriority())) >= highestQueuedLevel) {
+    NextJobRunLength.set(runLength + 1);
+    return job;
+  }
+  enqueueOnQueues(job);
+  return nullptr;
+}
+
+/// Put the job in this thread's NextJob slot, if any, on the queues,
+/// because the thread is about to stop running jobs.
+static void flushNextJob() {
+  if (auto job = exchangeNextJob(nullptr))
+    enqueueOnQueues(job);
+}
+
+/// Insert several jobs into the global queue at once.  The jobs are
+/// first linked by priority level and then published with a single
+/// synchronizing operation, waking at most one idle thread per job.
+void insertBatchIntoJobQueue(Job **jobs, size_t count) {
+  if (count == 0)
+    return;
+  for (size_t i = 0; i < count; ++i)
+    noteJobQueued(jobs[i]);
+  if (UseDispatch) {
+    for (size_t i = 0; i < count; ++i)
+      enqueueOnDispatch(jobs[i]);
+    return;
+  }
+  if (UseWorkerPool)
+    return enqueueBatchOnWorkerPool(jobs, count);
+
+  JobBatch batch;
+  for (size_t i = 0; i < count; ++i)
+    batch.push(jobs[i]);
+
+  if (IsDrainingThread.get()) {
+    JobQueue.append(batch);
+  } else {
+    auto chain = batch.takeAll();
+    ForeignJobQueue.pushChain(chain.first, chain.second);
+    unparkIdleThreads(1);
+  }
+}
+
+/// Move every job that other threads have enqueued so far into the
+/// priority queues.
+static void spliceForeignJobs() {
+  while (auto job = ForeignJobQueue.pop())
+    JobQueue.push(job);
+}
+
+/// Claim the next job from the cooperative global queue.
+Job *claimNextFromJobQueue() {
+  spliceForeignJobs();
+  return JobQueue.pop();
+}
+
+static int getHighestLevel(uint32_t levels) {
+  return levels ? int(llvm::findLastSet(levels, llvm::ZB_Undefined)) : -1;
+}
+
+/// Claim the next job for the thread draining the cooperative global
+/// queue, trying its NextJob slot first.
+static Job *claimNextForDrainingThread() {
+  spliceForeignJobs();
+  if (auto job = takeNextJob(getHighestLevel(JobQueue.getNonEmptyLevels())))
+    return job;
+  NextJobRunLength.set(0);
+  unsigned tenant;
+  auto job = JobQueue.pop(tenant);
+  chargeTenantForNextJob(tenant);
+  return job;
+}
+
+/// Is there any job that \p worker could claim?
+static bool hasVisibleWork(WorkerThread *worker) {
+  auto levels = getWorkerLevels(worker);
+  if ((GlobalNonEmptyLevels.load(std::memory_order_acquire) & levels) ||
+      !ForeignJobQueue.isEmpty())
+    return true;
+  for (unsigned i = 0; i < Pool->NumWorkers; ++i) {
+    auto other = &Pool->Workers[i];
+    for (unsigned level = 0; level < NumJobPriorityLevels; ++level)
+      if ((levels & (1u << level)) && !other->LocalQueues[level].isEmpty())
+        return true;
+    if (!(getWorkerLevels(other) & ~levels) && !other->Inbox.isEmpty())
+      return true;
+  }
+  return false;
+}
+
+void my_swift::setPriorityAgingInterval(uint64_t intervalNanos) {
+  AgingIntervalNanos.store(intervalNanos, std::memory_order_relaxed);
+}
+
+void my_swift::setQueueStatisticsEnabled(bool enabled) {
+  if (enabled)
+    JobQueue.resetStatistics();
+  CollectQueueStatistics.store(enabled, std::memory_order_relaxed);
+}
+
+QueueWaitStatistics my_swift::getQueueStatistics(unsigned level) {
+  if (level >= NumJobPriorityLevels)
+    return QueueWaitStatistics();
+  return JobQueue.getStatistics(level);
+}
+
+void my_swift::wakeGlobalExecutorThreads() {
+  unparkIdleThreads(UINT_MAX);
+}
+
+SWIFT_CC(swift)
+void (*my_swift::swift_task_escalateGlobal_hook)(Job *job,
+                                                JobPriority newPriority) =
+    nullptr;
+
+void my_swift::escalateGlobalJob(Job *job, JobPriority newPriority) {
+  if (swift_task_escalateGlobal_hook)
+    swift_task_escalateGlobal_hook(job, newPriority);
+}
+
+namespace {
+/// A request to escalate a task, sent to the draining thread.
+struct EscalationRequest {
+  AsyncTask *Task;
+  JobPriority NewPriority;
+};
+} // end anonymous namespace
+
+/// Escalate a job in JobQueue, moving its count to its new level.
+static bool escalateQueuedJob(Job *job, JobPriority newPriority) {
+  auto level = getJobPriorityLevel(job->getPriority());
+  if (!JobQueue.escalate(job, newPriority))
+    return false;
+  adjustQueueDepth(level, -1);
+  adjustQueueDepth(getJobPriorityLevel(newPriority), 1);
+  return true;
+}
+
+/// Move an escalated job that is waiting in the global queue ahead of
+/// lower-priority jobs.  This can be called from any thread.
+///
+/// Only jobs in the global queue's FIFOs move.  Jobs in a NextJob slot,
+/// a worker's deque or inbox, or the injection queue are never moved, and
+/// neither are jobs with a deadline or a tenant, or jobs that have been
+/// handed to Dispatch.
+void requeueEscalatedJob(Job *job, JobPriority newPriority) {
+  if (UseDispatch)
+    return;
+  if (UseWorkerPool) {
+    {
+      std::lock_guard<std::mutex> guard(Pool->GlobalQueueLock);
+      if (!escalateQueuedJob(job, newPriority))
+        return;
+      publishGlobalLevels();
+    }
+    // The job may have moved to another band, whose workers are idle.
+    if (Pool->NumBands)
+      unparkIdleThreadsForLevel(getJobPriorityLevel(newPriority), 1);
+    return;
+  }
+  if (IsDrainingThread.get()) {
+    escalateQueuedJob(job, newPriority);
+    return;
+  }
+
+  // Only the draining thread may touch JobQueue, so send it the request
+  // at the highest priority.  Only a task can be kept alive until then.
+  auto task = dyn_cast<AsyncTask>(job);
+  if (!task)
+    return;
+  swift_retain(task);
+  insertIntoJobQueue(new CallbackJob(
+      JobPriority::UserInteractive,
+      [](void *context) {
+        auto request = static_cast<EscalationRequest*>(context);
+        escalateQueuedJob(request->Task, request->NewPriority);
+        swift_release(request->Task);
+        delete request;
+      },
+      new EscalationRequest{task, newPriority}));
+}
+
+/// Cancel a queued task of a priority level below \p level, so that it
+/// winds down as soon as it runs, and return whether there was one.
+/// Discarding the task instead would leave whoever awaits it waiting
+/// forever.  Only tasks in the global queue's FIFOs are considered, and
+/// only where this thread can search them: not on Dispatch, and not off
+/// the draining thread of the cooperative executor.
+static bool cancelQueuedTaskBelow(unsigned level) {
+  AsyncTask *task = nullptr;
+  if (UseWorkerPool) {
+    std::lock_guard<std::mutex> guard(Pool->GlobalQueueLock);
+    spliceForeignJobs();
+    publishGlobalLevels();
+    task = JobQueue.findUncancelledTaskBelow(level);
+    if (task)
+      swift_retain(task);
+  } else if (!UseDispatch && IsDrainingThread.get()) {
+    spliceForeignJobs();
+    task = JobQueue.findUncancelledTaskBelow(level);
+    if (task)
+      swift_retain(task);
+  }
+  if (!task)
+    return false;
+  // Cancelling runs the task's cancellation handlers, which may enqueue
+  // jobs, so it must not happen under the queue lock.
+  swift_task_cancel(task);
+  swift_release(task);
+  return true;
+}
+
+Job *my_swift::getRunningJob() {
+  return RunningJob.get();
+}
+
+void my_swift::inheritPriority(AsyncTask *task, JobPriority waiterPriority) {
+  if (waiterPriority == JobPriority::Unspecified)
+    return;
+  // The runtime records the escalation on the task and on its child
+  // tasks.  Only the task itself moves up in the global queue, if it is
+  // still queued there; children that are queued keep their place.
+  swift_task_escalate(task, waiterPriority);
+  escalateGlobalJob(task, waiterPriority);
+}
+
+uint64_t my_swift::enqueueGlobalAfter(Job *job, uint64_t delayNanos) {
+  if (delayNanos == 0) {
+    insertIntoJobQueue(job);
+    return 0;
+  }
+
+  // Round the expiry up to a whole tick so that the job never runs early.
+  auto now = getCurrentNanos();
+  auto tickNanos = uint64_t(1) << TimerTickShift;
+  auto expiry = delayNanos > UINT64_MAX - now - tickNanos
+    ? UINT64_MAX >> TimerTickShift
+    : (now + delayNanos + tickNanos - 1) >> TimerTickShift;
+
+  uint64_t timerID;
+  {
+    std::lock_guard<std::mutex> guard(Timers.Lock);
+    if (expiry <= Timers.Wheel.getCurrentTick()) {
+      timerID = 0;
+    } else {
+      timerID = Timers.Wheel.insert(job, expiry);
+      auto nextTick = Timers.Wheel.getNextWakeTick();
+      if (nextTick == NextTimerTick.load(std::memory_order_relaxed))
+        return timerID;
+      NextTimerTick.store(nextTick, std::memory_order_release);
+    }
+  }
+
+  if (timerID == 0) {
+    insertIntoJobQueue(job);
+  } else {
+    // The earliest timer moved up, so whichever thread is sleeping until
+    // the old one must wake up and sleep again for less.
+    unparkIdleThreads(UINT_MAX);
+  }
+  return timerID;
+}
+
+Job *my_swift::cancelGlobalTimer(uint64_t timerID) {
+  std::lock_guard<std::mutex> guard(Timers.Lock);
+  auto job = Timers.Wheel.cancel(timerID);
+  if (job)
+    NextTimerTick.store(Timers.Wheel.getNextWakeTick(),
+                        std::memory_order_release);
+  return job;
+}
+
+void my_swift::enqueueCallbackOnExecutor(ExecutorRef executor,
+                                         JobPriority priority,
+                                         void (*callback)(void *),
+                                         void *context) {
+  enqueueOnExecutor(new CallbackJob(priority, callback, context), executor);
+}
+
+void my_swift::enqueueCallbackOnExecutor(SerialExecutor *executor,
+                                         JobPriority priority,
+                                         void (*callback)(void *),
+                                         void *context) {
+  executor->enqueue(new CallbackJob(priority, callback, context));
+}
+
+uint64_t my_swift::enqueueGlobalCallbackAfter(uint64_t delayNanos,
+                                              JobPriority priority,
+                                              void (*callback)(void *),
+                                              void *context) {
+  return enqueueGlobalAfter(new CallbackJob(priority, callback, context),
+                            delayNanos);
+}
+
+static Reactor *getReactor() {
+  static Reactor *reactor = [] {
+    auto reactor = new Reactor();
+    IOReactor.store(reactor, std::memory_order_release);
+    return reactor;
+  }();
+  return reactor;
+}
+
+/// Hand \p job to the reactor until \p fd is ready.  Returns false if the
+/// descriptor cannot be waited on, either because it is always ready,
+/// like a regular file, or because there is no reactor on this platform.
+static bool watchDescriptor(Job *job, int fd, bool forWriting) {
+  auto reactor = getReactor();
+  if (!reactor->watch(job, fd, forWriting))
+    return false;
+
+  // A thread blocked in the reactor will see the new descriptor.  If
+  // there is none, wake the idle threads so that one of them starts
+  // waiting on the reactor instead of only on timers.
+  if (!reactor->isBlocked())
+    unparkEveryBand(UINT_MAX);
+  return true;
+}
+
+void my_swift::enqueueGlobalWhenReady(Job *job, int fd, bool forWriting) {
+  // Let a job whose descriptor cannot be waited on find out for itself.
+  if (!watchDescriptor(job, fd, forWriting))
+    insertIntoJobQueue(job);
+}
+
+void my_swift::unwatchGlobalDescriptor(int fd) {
+  auto reactor = IOReactor.load(std::memory_order_acquire);
+  if (!reactor)
+    return;
+  std::vector<Job*> released;
+  reactor->unwatch(fd, [&](Job *job) { released.push_back(job); });
+  insertBatchIntoJobQueue(released.data(), released.size());
+}
+
+void my_swift::enqueueGlobalCallbackWhenReady(int fd, bool forWriting,
+                                              JobPriority priority,
+                                              void (*callback)(void *),
+                                              void *context) {
+  enqueueGlobalWhenReady(new CallbackJob(priority, callback, context), fd,
+                         forWriting);
+}
+
+/// Enqueue the jobs whose file descriptors are ready, without blocking.
+/// Returns true if there were any.
+static bool pollReactor() {
+  auto reactor = IOReactor.load(std::memory_order_acquire);
+  if (!reactor || !reactor->hasWaiters())
+    return false;
+  std::vector<Job*> ready;
+  reactor->poll([&](Job *job) { ready.push_back(job); });
+  insertBatchIntoJobQueue(ready.data(), ready.size());
+  return !ready.empty();
+}
+
+static IOUring *getIOUring() {
+  static IOUring *ring = new IOUring(256);
+  return ring;
+}
+
+/// Whether ReapJob is waiting on the ring's descriptor in the reactor,
+/// or about to run.
+static std::atomic<bool> IsIOUringWatched{false};
+
+static void watchIOUring();
+static void performWithoutIOUring(IOJob *job);
+
+/// Enqueue the I/O jobs whose operations have completed.  Returns true
+/// if there were any.
+///
+/// The kernel may complete an operation on a non-blocking descriptor
+/// with -EAGAIN instead of waiting for it to become ready.  Such a job
+/// is not complete: it waits for readiness and performs the operation
+/// itself, as it would without io_uring.
+static bool reapIOUring(IOUring *ring) {
+  std::vector<Job*> completed;
+  std::vector<IOJob*> wouldBlock;
+  ring->reap([&](void *userData, int32_t result) {
+    auto job = static_cast<IOJob*>(userData);
+    if (result == -EAGAIN || result == -EWOULDBLOCK) {
+      wouldBlock.push_back(job);
+      return;
+    }
+    job->Result = result;
+    job->IsComplete = true;
+    completed.push_back(job);
+  });
+  for (auto job : wouldBlock)
+    performWithoutIOUring(job);
+  insertBatchIntoJobQueue(completed.data(), completed.size());
+  return !completed.empty() || !wouldBlock.empty();
+}
+
+namespace {
+/// The job that the reactor releases when the ring has completions, so
+/// that an idle thread blocked in the reactor also wakes up for them.
+class ReapJob : public Job {
+  SWIFT_CC(swiftasync)
+  static void process(Job *job, ExecutorRef executor) {
+    auto ring = getIOUring();
+    reapIOUring(ring);
+    IsIOUringWatched.store(false, std::memory_order_seq_cst);
+    if (ring->hasInFlight())
+      watchIOUring();
+  }
+
+public:
+  ReapJob()
+    : Job(JobFlags(CallbackJob::Kind, JobPriority::UserInteractive),
+          &process) {}
+};
+} // end anonymous namespace
+
+/// Make sure that ReapJob will run when the ring next has completions.
+static void watchIOUring() {
+  static ReapJob *reapJob = new ReapJob();
+  if (!IsIOUringWatched.exchange(true, std::memory_order_seq_cst))
+    enqueueGlobalWhenReady(reapJob, getIOUring()->getFileDescriptor(),
+                           /*forWriting*/ false);
+}
+
+void my_swift::submitGlobalIO(IOOperation operation, int fd, void *buffer,
+                              uint32_t length, uint64_t offset,
+                              JobPriority priority,
+                              void (*callback)(void *, int32_t),
+                              void *context) {
+  auto job = new IOJob(priority, operation, fd, buffer, length, offset,
+                       callback, context);
+  auto ring = getIOUring();
+  if (ring->submit(operation, fd, buffer, length, offset, job)) {
+    // Executor threads hand their submissions to the kernel in one batch
+    // when they next check for events.  Other threads have no such
+    // point, so they submit right away.
+    if (!isExecutorThread())
+      ring->flush();
+    watchIOUring();
+    return;
+  }
+
+  // No io_uring, or it is full.
+  performWithoutIOUring(job);
+}
+
+/// Perform \p job's operation once its descriptor is ready instead of
+/// through io_uring.  Readiness means nothing for regular files, which
+/// never make a reader wait short of the disk, or for fsync, so those
+/// would block whichever executor thread performed them; they go to the
+/// blocking pool.
+static void performWithoutIOUring(IOJob *job) {
+  if (job->Operation == IOOperation::Fsync ||
+      !watchDescriptor(job, job->FD, job->isWrite()))
+    job->performOnBlockingPool();
+}
+
+void IOJob::performOnBlockingPool() {
+  runBlocking([](void *context) {
+    auto self = static_cast<IOJob*>(context);
+    self->Result = self->performInline();
+    self->IsComplete = true;
+    insertIntoJobQueue(self);
+  }, this);
+}
+
+int32_t IOJob::performInline() {
+  ssize_t result = -1;
+  switch (Operation) {
+  case IOOperation::Read:
+    result = Offset == UINT64_MAX ? read(FD, Buffer, Length)
+                                  : pread(FD, Buffer, Length, off_t(Offset));
+    break;
+  case IOOperation::Write:
+    result = Offset == UINT64_MAX ? write(FD, Buffer, Length)
+                                  : pwrite(FD, Buffer, Length, off_t(Offset));
+    break;
+  case IOOperation::Accept:
+#if defined(__linux__)
+    result = accept4(FD, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+    result = accept(FD, nullptr, nullptr);
+#endif
+    break;
+  case IOOperation::Fsync:
+    result = fsync(FD);
+    break;
+  }
+  return result < 0 ? -errno : int32_t(result);
+}
+
+void IOJob::process(Job *job, ExecutorRef executor) {
+  auto self = static_cast<IOJob*>(job);
+  if (!self->IsComplete) {
+    self->Result = self->performInline();
+    if (self->Result == -EAGAIN || self->Result == -EWOULDBLOCK) {
+      enqueueGlobalWhenReady(self, self->FD, self->isWrite());
+      return;
+    }
+  }
+  auto callback = self->Callback;
+  auto context = self->Context;
+  auto result = self->Result;
+  delete self;
+  callback(context, result);
+}
+
+/// Submit the I/O operations queued so far and enqueue the jobs of the
+/// ones that have completed.  Returns true if there were any.
+static bool pollIOUring() {
+  auto ring = getIOUring();
+  if (!ring->hasInFlight())
+    return false;
+  ring->flush();
+  return reapIOUring(ring);
+}
+
+/// Enqueue the jobs of every timer that has come due.  Returns true if
+/// there were any.  If another thread is already doing this, return
+/// false without waiting for it.
+static bool fireExpiredTimers() {
+  auto nextTick = NextTimerTick.load(std::memory_order_acquire);
+  if (nextTick == UINT64_MAX)
+    return false;
+  auto now = getCurrentNanos() >> TimerTickShift;
+  if (now < nextTick)
+    return false;
+
+  std::unique_lock<std::mutex> guard(Timers.Lock, std::try_to_lock);
+  if (!guard.owns_lock())
+    return false;
+  std::vector<Job*> expired;
+  Timers.Wheel.advance(now, [&](Job *job) { expired.push_back(job); });
+  NextTimerTick.store(Timers.Wheel.getNextWakeTick(),
+                      std::memory_order_release);
+  guard.unlock();
+
+  insertBatchIntoJobQueue(expired.data(), expired.size());
+  return !expired.empty();
+}
+
+/// Submit queued I/O, and enqueue the jobs of expired timers, ready
+/// file descriptors and completed I/O.  Returns true if there were any.
+static bool pollEventSources() {
+  bool fired = fireExpiredTimers();
+  bool completed = pollIOUring();
+  bool polled = pollReactor();
+  return fired || completed || polled;
+}
+
+static void pushOntoGlobalQueue(Job *job);
+
+/// Whether any worker has a job in its NextJob slot.
+static bool hasOccupiedNextJobSlots() {
+  if (!Pool)
+    return false;
+  for (unsigned i = 0; i < Pool->NumWorkers; ++i)
+    if (Pool->Workers[i].NextJobSlot.load(std::memory_order_relaxed))
+      return true;
+  return false;
+}
+
+/// When the watcher last ran noteNextJobSlots.  Only the watcher uses it.
+static uint64_t NextJobSlotsNotedAt = 0;
+
+/// Record what each worker has in its NextJob slot and how many jobs it
+/// has started, before the watcher parks.
+static void noteNextJobSlots() {
+  NextJobSlotsNotedAt = getCurrentNanos();
+  for (unsigned i = 0; i < Pool->NumWorkers; ++i) {
+    auto &worker = Pool->Workers[i];
+    worker.SeenNextJob = worker.NextJobSlot.load(std::memory_order_relaxed);
+    worker.SeenJobsStarted = worker.JobsStarted.load(std::memory_order_relaxed);
+  }
+}
+
+/// Move each job that has waited in a worker's NextJob slot since
+/// noteNextJobSlots, at least NextJobStallNanos ago, while the worker
+/// has not started another job, to the global queue.  Only the worker
+/// that filled the slot could otherwise run it, and it is still busy
+/// with the job that filled it.
+static void publishStalledNextJobs() {
+  if (getCurrentNanos() - NextJobSlotsNotedAt < NextJobStallNanos)
+    return;
+  for (unsigned i = 0; i < Pool->NumWorkers; ++i) {
+    auto &worker = Pool->Workers[i];
+    auto job = worker.NextJobSlot.load(std::memory_order_relaxed);
+    if (!job || job != worker.SeenNextJob ||
+        worker.JobsStarted.load(std::memory_order_relaxed) !=
+          worker.SeenJobsStarted)
+      continue;
+    if (!worker.NextJobSlot.compare_exchange_strong(
+            job, nullptr, std::memory_order_acquire))
+      continue;
+    auto level = getJobPriorityLevel(job->getPriority());
+    pushOntoGlobalQueue(job);
+    unparkIdleThreadsForLevel(level, 1);
+  }
+}
+
+/// Wake a thread that can watch the workers' NextJob slots, after one of
+/// them was filled, unless there is a watcher already.  A watcher that
+/// is about to stop watching looks at the slots again before it parks.
+static void ensureNextJobsWatched() {
+  if (HasWatcher.load(std::memory_order_relaxed))
+    return;
+  if (Pool->NumBands)
+    Pool->Bands[unsigned(WorkerBand::Default)].IdleThreads.unparkOne();
+  else
+    IdleThreads.unparkOne();
+}
+
+/// Park the current thread until \p isReady returns true or it is
+/// unparked.  One idle thread at a time, the watcher, also wakes up when
+/// the earliest timer comes due, and blocks in the reactor instead of
+/// parking if any job is waiting on a file descriptor.  The others rely
+/// on it, or on a thread that is still running jobs, to enqueue those
+/// jobs and unpark them.  While a worker has a job in its NextJob slot,
+/// the watcher also wakes up every NextJobStallNanos, to publish that
+/// job if the worker is still running the same job.  The thread parks
+/// on \p idleThreads with \p wakeMask, and only becomes the watcher if
+/// \p canWatch.
+template <class Fn>
+static void parkUntilWorkOrEvent(Fn isReady,
+                                 ThreadParker &idleThreads = IdleThreads,
+                                 uint32_t wakeMask = ThreadParker::AnyWaiter,
+                                 bool canWatch = true) {
+  auto nextTick = NextTimerTick.load(std::memory_order_acquire);
+  auto reactor = IOReactor.load(std::memory_order_acquire);
+  bool hasIOWaiters = reactor && reactor->hasWaiters();
+  bool watchesSlots = canWatch && hasOccupiedNextJobSlots();
+  bool isWatcher = canWatch &&
+                   (nextTick != UINT64_MAX || hasIOWaiters || watchesSlots) &&
+                   !HasWatcher.exchange(true, std::memory_order_acquire);
+  auto timeout = UINT64_MAX;
+  if (isWatcher && nextTick != UINT64_MAX) {
+    auto deadline = nextTick << TimerTickShift;
+    auto now = getCurrentNanos();
+    timeout = deadline > now ? deadline - now : 0;
+  }
+  if (isWatcher && watchesSlots) {
+    noteNextJobSlots();
+    timeout = std::min<uint64_t>(timeout, NextJobStallNanos);
+  }
+
+  auto isReadyOrChanged = [&] {
+    if (isReady() ||
+        NextTimerTick.load(std::memory_order_relaxed) != nextTick)
+      return true;
+    // A worker filled its NextJob slot while nobody watches the slots.
+    if (canWatch && !isWatcher &&
+        !HasWatcher.load(std::memory_order_relaxed) &&
+        hasOccupiedNextJobSlots())
+      return true;
+    // A job started waiting on a descriptor that nobody is polling.
+    if (canWatch && !hasIOWaiters) {
+      auto reactor = IOReactor.load(std::memory_order_relaxed);
+      return reactor && reactor->hasWaiters();
+    }
+    return false;
+  };
+
+  if (isWatcher && hasIOWaiters) {
+    std::vector<Job*> ready;
+    reactor->block(timeout, isReadyOrChanged,
+                   [&](Job *job) { ready.push_back(job); });
+    if (watchesSlots)
+      publishStalledNextJobs();
+    HasWatcher.store(false, std::memory_order_release);
+    insertBatchIntoJobQueue(ready.data(), ready.size());
+    return;
+  }
+
+  idleThreads.parkFor(timeout, isReadyOrChanged, wakeMask);
+  if (isWatcher) {
+    if (watchesSlots)
+      publishStalledNextJobs();
+    HasWatcher.store(false, std::memory_order_release);
+  }
+}
+
+/// Can \p worker, or a thread that is not a worker, be the watcher?
+/// A worker of the Background band cannot: it runs under SCHED_BATCH at
+/// a raised nice value, so the jobs of every band would wait for it to
+/// be scheduled when a timer fires or a descriptor becomes ready.  There
+/// is always a worker of another band to watch instead, or, while they
+/// are all busy, to poll between its jobs.
+static bool canWatchEvents(WorkerThread *worker) {
+  return !worker || !worker->Band ||
+         worker->Band->Band != WorkerBand::Background;
+}
+
+/// Wait until there may be work for \p worker to claim or the given
+/// condition, if any, becomes true.
+static void waitForWork(WorkerThread *worker, bool (*condition)(void *),
+                        void *conditionContext) {
+  parkUntilWorkOrEvent([&] {
+    return hasVisibleWork(worker) ||
+           (condition && condition(conditionContext));
+  }, getIdleThreads(worker), getWakeMask(worker), canWatchEvents(worker));
+}
+
+static void publishGlobalLevels() {
+  GlobalNonEmptyLevels.store(JobQueue.getNonEmptyLevels(),
+                             std::memory_order_release);
+  GlobalDeadlineLevels.store(JobQueue.getDeadlineLevels(),
+                             std::memory_order_release);
+  GlobalTenantLevels.store(JobQueue.getTenantLevels(),
+                           std::memory_order_release);
+  GlobalOldestServedAt.store(JobQueue.getOldestServedAt(),
+                             std::memory_order_relaxed);
+}
+
+/// Has a level of the global queue gone unserved for an aging interval
+/// or more?  Its jobs then run ahead of local ones, whatever their level.
+static bool hasAgedGlobalJobs() {
+  auto interval = AgingIntervalNanos.load(std::memory_order_relaxed);
+  if (!interval)
+    return false;
+  auto oldest = GlobalOldestServedAt.load(std::memory_order_relaxed);
+  if (oldest == UINT64_MAX)
+    return false;
+  auto now = getCurrentNanos();
+  return now > oldest && now - oldest >= interval;
+}
+
+/// Can \p job go on \p worker's local deque?  Jobs that must be ordered
+/// by deadline or tenant go through the global queue instead, and jobs
+/// of another band would only wait there to be stolen.
+static bool canEnqueueLocally(Job *job, WorkerThread *worker) {
+  return !needsGlobalOrdering(job) &&
+         (getWorkerLevels(worker) &
+          (1u << getJobPriorityLevel(job->getPriority())));
+}
+
+static void pushOntoGlobalQueue(Job *job) {
+  std::lock_guard<std::mutex> guard(Pool->GlobalQueueLock);
+  JobQueue.push(job);
+  publishGlobalLevels();
+}
+
+/// Claim the highest-priority job among \p levels from the global queue
+/// if its level is above the given one.
+static Job *claimFromGlobalQueueAbove(int level, uint32_t levels) {
+  std::lock_guard<std::mutex> guard(Pool->GlobalQueueLock);
+  spliceForeignJobs();
+  Job *job = nullptr;
+  unsigned tenant = MaxTenants;
+  if (getHighestLevel(JobQueue.getNonEmptyLevels() & levels) > level)
+    job = JobQueue.pop(tenant, levels);
+  publishGlobalLevels();
+  chargeTenantForNextJob(tenant);
+  return job;
+}
+
+/// Steal a job from another worker, preferring higher priority levels
+/// and starting at a random victim within each level.  Within a level,
+/// workers on the thief's NUMA node are tried before the others, so that
+/// a job and the memory it last touched stay on one node if possible.
+/// Only jobs of a level above \p aboveLevel are taken, and jobs directed
+/// at other workers only if there is no such bound.
+static Job *stealFromOtherWorkers(WorkerThread *thief, int aboveLevel = -1) {
+  auto start = thief ? thief->nextRandom() : 0;
+  auto levels = getWorkerLevels(thief);
+  bool preferLocal = thief && Pool->Nodes.size() > 1;
+  for (int level = NumJobPriorityLevels - 1; level > aboveLevel; --level) {
+    if (!(levels & (1u << level)))
+      continue;
+    for (int pass = 0; pass < (preferLocal ? 2 : 1); ++pass) {
+      for (unsigned i = 0; i < Pool->NumWorkers; ++i) {
+        auto victim = &Pool->Workers[(start + i) % Pool->NumWorkers];
+        if (victim == thief)
+          continue;
+        if (preferLocal && (victim->Node == thief->Node) != (pass == 0))
+          continue;
+        if (auto job = victim->LocalQueues[level].steal())
+          return job;
+      }
+    }
+  }
+
+  if (aboveLevel >= 0)
+    return nullptr;
+
+  // Then the jobs directed at other workers that they have not taken
+  // yet, as long as the thief can run everything that its victim can.
+  for (unsigned i = 0; i < Pool->NumWorkers; ++i) {
+    auto victim = &Pool->Workers[(start + i) % Pool->NumWorkers];
+    if (victim == thief || (getWorkerLevels(victim) & ~levels) ||
+        victim->Inbox.isEmpty())
+      continue;
+    std::unique_lock<std::mutex> guard(victim->InboxLock, std::try_to_lock);
+    if (!guard.owns_lock())
+      continue;
+    if (auto job = victim->Inbox.pop()) {
+      victim->InboxDepth.fetch_sub(1, std::memory_order_relaxed);
+      return job;
+    }
+  }
+  return nullptr;
+}
+
+/// Move the jobs that other threads directed at \p worker to its deques,
+/// or to the global queue if they are full.
+static void takeInbox(WorkerThread *worker) {
+  if (worker->Inbox.isEmpty())
+    return;
+  std::lock_guard<std::mutex> guard(worker->InboxLock);
+  while (auto job = worker->Inbox.pop()) {
+    worker->InboxDepth.fetch_sub(1, std::memory_order_relaxed);
+    auto level = getJobPriorityLevel(job->getPriority());
+    if (!worker->LocalQueues[level].push(job))
+      pushOntoGlobalQueue(job);
+  }
+}
+
+/// Claim the next job to run on a thread of the worker pool.  \p worker
+/// is null for a thread that was donated without being a pool worker.
+///
+/// A worker prefers its own deques, but never runs a local job while the
+/// global queue holds a job of higher priority.  Only when both are
+/// empty does it steal, taking the highest priority job it can find.
+/// A worker of a band only considers the levels of its band.
+///
+/// Other workers' deques are not checked before each local job, since
+/// that would cost a cache miss per worker and level.  A job of higher
+/// priority queued there may wait behind up to EventCheckInterval local
+/// jobs, after which the worker looks for one and steals it.
+static Job *claimNextForWorker(WorkerThread *worker) {
+  auto levels = getWorkerLevels(worker);
+  if (worker)
+    takeInbox(worker);
+  int localLevel = worker ? worker->getHighestLocalLevel() : -1;
+  int globalLevel = getHighestLevel(
+    GlobalNonEmptyLevels.load(std::memory_order_acquire) & levels);
+  if (hasNextJob()) {
+    if (auto job = takeNextJob(std::max(localLevel, globalLevel)))
+      return job;
+    // The job went on the queues, so look at them again.
+    localLevel = worker ? worker->getHighestLocalLevel() : -1;
+    globalLevel = getHighestLevel(
+      GlobalNonEmptyLevels.load(std::memory_order_acquire) & levels);
+  }
+  NextJobRunLength.set(0);
+
+  // Jobs with a deadline in the global queue run ahead of local jobs
+  // of the same level.
+  int minGlobalLevel = localLevel;
+  if (localLevel >= 0 &&
+      (GlobalDeadlineLevels.load(std::memory_order_acquire) &
+       (1u << localLevel)))
+    minGlobalLevel = localLevel - 1;
+  if (globalLevel >= 0 && hasAgedGlobalJobs())
+    minGlobalLevel = -1;
+
+  if (globalLevel > minGlobalLevel || !ForeignJobQueue.isEmpty()) {
+    if (auto job = claimFromGlobalQueueAbove(minGlobalLevel, levels))
+      return job;
+  }
+  if (localLevel >= 0) {
+    if (worker->JobsStarted.load(std::memory_order_relaxed) %
+          EventCheckInterval == 0) {
+      if (auto job = stealFromOtherWorkers(worker, localLevel))
+        return job;
+    }
+    if (auto job = worker->LocalQueues[localLevel].steal())
+      return job;
+  }
+  return stealFromOtherWorkers(worker);
+}
+
+static void enqueueOnWorkerPool(Job *job) {
+  auto worker = CurrentWorker.get();
+  auto level = getJobPriorityLevel(job->getPriority());
+  if (!worker) {
+    ForeignJobQueue.push(job);
+  } else {
+    if (!canEnqueueLocally(job, worker) ||
+        !worker->LocalQueues[level].push(job))
+      pushOntoGlobalQueue(job);
+  }
+  unparkIdleThreadsForLevel(level, 1);
+}
+
+/// How many jobs a worker may have queued locally and still be sent
+/// jobs by enqueueGlobalOnWorker, or 0 to never direct jobs at workers.
+static std::atomic<size_t> WorkerAffinityThreshold{8};
+
+void my_swift::setWorkerAffinityThreshold(size_t maxQueuedJobs) {
+  WorkerAffinityThreshold.store(maxQueuedJobs, std::memory_order_relaxed);
+}
+
+unsigned my_swift::getCurrentGlobalWorker() {
+  auto worker = CurrentWorker.get();
+  return worker ? unsigned(worker - Pool->Workers) + 1 : 0;
+}
+
+/// The number of jobs queued on \p worker's deques and inbox.
+static size_t getWorkerLoad(WorkerThread *worker) {
+  auto load = worker->InboxDepth.load(std::memory_order_relaxed);
+  for (auto &queue : worker->LocalQueues)
+    load += queue.size();
+  return load;
+}
+
+/// Enqueue \p job on the global executor behind the jobs already queued,
+/// never in the NextJob slot.  Only executor threads use that slot, and
+/// only they can be sure that the global executor is this one.
+static void enqueueGlobalBehindQueued(Job *job) {
+  if (!isExecutorThread())
+    return swift_task_enqueueGlobal(job);
+  noteJobQueued(job);
+  enqueueOnQueues(job);
+}
+
+void my_swift::enqueueGlobalOnWorker(Job *job, unsigned workerID) {
+  auto threshold = WorkerAffinityThreshold.load(std::memory_order_relaxed);
+  if (!UseWorkerPool || !threshold || workerID == 0 ||
+      workerID > Pool->NumWorkers || workerID == getCurrentGlobalWorker())
+    return enqueueGlobalBehindQueued(job);
+
+  auto worker = &Pool->Workers[workerID - 1];
+  if (!canEnqueueLocally(job, worker) || getWorkerLoad(worker) >= threshold)
+    return enqueueGlobalBehindQueued(job);
+
+  // Once pushed, the job may be stolen, run and freed before we wake
+  // anyone, so read its level first.
+  auto level = getJobPriorityLevel(job->getPriority());
+  noteJobQueued(job);
+  worker->InboxDepth.fetch_add(1, std::memory_order_relaxed);
+  worker->Inbox.push(job);
+
+  // Wake the worker itself.  If it is not parked, it is running a job or
+  // watching for events; wake it in the reactor, and let an idle worker
+  // steal the job rather than have it wait behind the running one.
+  if (!getIdleThreads(worker).unparkMatching(getWakeMask(worker)))
+    unparkIdleThreadsForLevel(level, 1);
+}
+
+static void enqueueBatchOnWorkerPool(Job **jobs, size_t count) {
+  JobBatch batch;
+  auto worker = CurrentWorker.get();
+  unsigned levelCounts[NumJobPriorityLevels] = {};
+  for (size_t i = 0; i < count; ++i) {
+    auto job = jobs[i];
+    auto level = getJobPriorityLevel(job->getPriority());
+    ++levelCounts[level];
+    if (!worker || !canEnqueueLocally(job, worker) ||
+        !worker->LocalQueues[level].push(job))
+      batch.push(job);
+  }
+
+  if (!batch.isEmpty()) {
+    if (!worker) {
+      auto chain = batch.takeAll();
+      ForeignJobQueue.pushChain(chain.first, chain.second);
+    } else {
+      std::lock_guard<std::mutex> guard(Pool->GlobalQueueLock);
+      JobQueue.append(batch);
+      publishGlobalLevels();
+    }
+  }
+  if (!Pool->NumBands) {
+    unparkIdleThreads(unsigned(std::min<size_t>(count, Pool->NumWorkers)));
+    return;
+  }
+  for (unsigned level = 0; level < NumJobPriorityLevels; ++level)
+    getIdleThreadsForLevel(level).unparkMany(levelCounts[level]);
+  interruptEventWaiters();
+}
+
+/// The nice value of the Background band's threads.
+enum : int { BackgroundBandNice = 10 };
+
+/// Put the current thread, a worker of \p band, in the band's OS
+/// scheduling class.  Each step that the OS refuses falls back to the
+/// ordinary class, so this never fails.
+static void applyBandScheduling(const WorkerBandState &band) {
+#if defined(__linux__)
+  switch (band.Band) {
+  case WorkerBand::Background: {
+    struct sched_param param = {};
+#if defined(SCHED_BATCH)
+    (void)pthread_setschedparam(pthread_self(), SCHED_BATCH, &param);
+#endif
+    // The nice value of a thread is set through its thread ID.
+    (void)setpriority(PRIO_PROCESS, id_t(syscall(SYS_gettid)),
+                      BackgroundBandNice);
+    break;
+  }
+  case WorkerBand::Interactive:
+    if (band.IsRealtime) {
+      struct sched_param param = {};
+      param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+      (void)pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    }
+    break;
+  case WorkerBand::Default:
+    break;
+  }
+#endif
+}
+
+/// Restrict the current thread, \p worker, to the CPUs of its NUMA node.
+/// Memory that the thread touches first, such as the slabs of the tasks
+/// it allocates, is then placed on that node by the kernel's default
+/// first-touch policy.
+static void pinToNUMANode(const WorkerThread &worker) {
+#if defined(__linux__)
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  for (auto cpu : Pool->Nodes[worker.Node].CPUs)
+    CPU_SET(cpu, &cpus);
+  (void)pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+#endif
+}
+
+static void runWorker(WorkerThread *worker) {
+  CurrentWorker.set(worker);
+  if (!Pool->Nodes.empty())
+    pinToNUMANode(*worker);
+  if (worker->Band)
+    applyBandScheduling(*worker->Band);
+  unsigned jobsSinceEventCheck = 0;
+  while (true) {
+    if (++jobsSinceEventCheck == EventCheckInterval) {
+      pollEventSources();
+      jobsSinceEventCheck = 0;
+    }
+    if (auto job = claimNextForWorker(worker)) {
+      worker->JobsStarted.store(
+        worker->JobsStarted.load(std::memory_order_relaxed) + 1,
+        std::memory_order_relaxed);
+      runJob(job);
+      continue;
+    }
+    if (!pollEventSources())
+      waitForWork(worker, nullptr, nullptr);
+  }
+}
+
+/// Whether startGlobalExecutorWorkers and startGlobalExecutorBands pin
+/// their workers to NUMA nodes.
+static bool UseNUMAPlacement = false;
+
+void my_swift::setNUMAPlacementEnabled(bool enabled) {
+  assert(!UseWorkerPool && "global executor worker pool already started");
+  UseNUMAPlacement = enabled;
+}
+
+/// Spread the workers over the NUMA nodes in proportion to the nodes'
+/// CPUs, in blocks of consecutive workers.  With bands, the workers of
+/// each band are consecutive, so each band is spread the same way.
+static void placeWorkersOnNUMANodes() {
+  auto nodes = readNUMATopology();
+  if (nodes.size() < 2)
+    return;
+
+  std::vector<unsigned> cpuNodes;
+  for (unsigned node = 0; node < nodes.size(); ++node)
+    cpuNodes.insert(cpuNodes.end(), nodes[node].CPUs.size(), node);
+  Pool->Nodes = std::move(nodes);
+
+  unsigned bandStart = 0;
+  while (bandStart < Pool->NumWorkers) {
+    auto band = Pool->Workers[bandStart].Band;
+    unsigned bandEnd = bandStart;
+    while (bandEnd < Pool->NumWorkers && Pool->Workers[bandEnd].Band == band)
+      ++bandEnd;
+    auto bandSize = bandEnd - bandStart;
+    for (unsigned i = 0; i < bandSize; ++i)
+      Pool->Workers[bandStart + i].Node =
+        cpuNodes[size_t(i) * cpuNodes.size() / bandSize];
+    bandStart = bandEnd;
+  }
+}
+
+/// Allocate the worker pool with \p numWorkers threads, without starting
+/// them.
+static void createWorkerPool(unsigned numWorkers) {
+  assert(!UseWorkerPool && "global executor worker pool already started");
+  assert(!UseDispatch && "global executor already runs on Dispatch");
+  Pool = new WorkerPool();
+  Pool->Workers = new WorkerThread[numWorkers];
+  Pool->NumWorkers = numWorkers;
+  for (unsigned i = 0; i < numWorkers; ++i)
+    Pool->Workers[i].RandomState = 2654435761u * (i + 1);
+}
+
+static void startWorkerPool() {
+  if (UseNUMAPlacement)
+    placeWorkersOnNUMANodes();
+  UseWorkerPool = true;
+  for (unsigned i = 0; i < Pool->NumWorkers; ++i)
+    std::thread(runWorker, &Pool->Workers[i]).detach();
+}
+
+void my_swift::startGlobalExecutorWorkers(unsigned numWorkers) {
+  if (numWorkers == 0)
+    numWorkers = std::max(1u, std::thread::hardware_concurrency());
+  createWorkerPool(numWorkers);
+  startWorkerPool();
+}
+
+void my_swift::startGlobalExecutorBands(
+    const unsigned (&numWorkers)[NumWorkerBands], bool realtimeInteractive) {
+  unsigned bandWorkers[NumWorkerBands];
+  unsigned totalWorkers = 0;
+  for (unsigned band = 0; band < NumWorkerBands; ++band) {
+    bandWorkers[band] = std::max(numWorkers[band], 1u);
+    totalWorkers += bandWorkers[band];
+  }
+  createWorkerPool(totalWorkers);
+
+  Pool->Bands = new WorkerBandState[NumWorkerBands];
+  Pool->NumBands = NumWorkerBands;
+  for (unsigned band = 0; band < NumWorkerBands; ++band) {
+    Pool->Bands[band].Band = WorkerBand(band);
+    Pool->Bands[band].Levels = 0;
+  }
+  Pool->Bands[unsigned(WorkerBand::Interactive)].IsRealtime =
+    realtimeInteractive;
+  for (unsigned level = 0; level < NumJobPriorityLevels; ++level) {
+    auto &band = Pool->Bands[unsigned(getWorkerBand(level))];
+    band.Levels |= 1u << level;
+    Pool->LevelBands[level] = &band;
+  }
+
+  unsigned worker = 0;
+  for (unsigned band = 0; band < NumWorkerBands; ++band)
+    for (unsigned i = 0; i < bandWorkers[band]; ++i)
+      Pool->Workers[worker++].Band = &Pool->Bands[band];
+  startWorkerPool();
+}
+
+bool my_swift::startGlobalExecutorOnDispatch() {
+#if SWIFT_CONCURRENCY_ENABLE_DISPATCH
+  assert(!UseDispatch && "global executor already runs on Dispatch");
+  assert(!UseWorkerPool && "global executor worker pool already started");
+
+  // JobPriority values are Dispatch QoS classes.  Unspecified, which is
+  // 0, selects the default-priority queue.
+  static const JobPriority LevelPriorities[NumJobPriorityLevels] = {
+    JobPriority::Unspecified, JobPriority::Background, JobPriority::Utility,
+    JobPriority::Default, JobPriority::UserInitiated,
+    JobPriority::UserInteractive,
+  };
+  for (unsigned level = 0; level < NumJobPriorityLevels; ++level)
+    DispatchQueues[level] =
+      dispatch_get_global_queue(intptr_t(LevelPriorities[level]), 0);
+  UseDispatch = true;
+  return true;
+#else
+  return false;
+#endif
+}
+
+/// Claim the next job for a thread that runs the global executor in
+/// whichever mode it is in.  Dispatch runs its own jobs.
+static Job *claimNextForCurrentThread() {
+  if (UseDispatch)
+    return nullptr;
+  if (UseWorkerPool)
+    return claimNextForWorker(CurrentWorker.get());
+  return claimNextForDrainingThread();
+}
+
+size_t my_swift::runGlobalExecutorFor(uint64_t maxNanos, size_t maxJobs) {
+#if defined(__linux__)
+  if (auto host = Host.load(std::memory_order_acquire)) {
+    host->IsArmed.store(false, std::memory_order_relaxed);
+    uint64_t value;
+    (void)read(host->EventFD, &value, sizeof(value));
+  }
+#endif
+
+  auto start = getCurrentNanos();
+  auto deadline = maxNanos && maxNanos < UINT64_MAX - start
+    ? start + maxNanos : UINT64_MAX;
+  bool isCooperative = !UseWorkerPool && !UseDispatch;
+  bool wasDraining = IsDrainingThread.get();
+  if (isCooperative)
+    IsDrainingThread.set(true);
+
+  size_t jobsRun = 0;
+  pollEventSources();
+  while (!maxJobs || jobsRun < maxJobs) {
+    auto job = claimNextForCurrentThread();
+    if (!job) {
+      if (pollEventSources())
+        continue;
+      break;
+    }
+    runJob(job);
+    if (++jobsRun % EventCheckInterval == 0)
+      pollEventSources();
+    if (deadline != UINT64_MAX && getCurrentNanos() >= deadline)
+      break;
+  }
+
+  if (isCooperative && !wasDraining) {
+    flushNextJob();
+    IsDrainingThread.set(false);
+  }
+
+  // Arm the wakeup before reading the depth, so that work published
+  // after the read makes the descriptor readable.
+  if (auto host = Host.load(std::memory_order_acquire))
+    host->IsArmed.store(true, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  return getTotalQueueDepth();
+}
+
+int my_swift::getGlobalExecutorWakeFD() {
+#if defined(__linux__)
+  static HostWakeup *host = [] {
+    auto host = new HostWakeup();
+    host->EpollFD = epoll_create1(EPOLL_CLOEXEC);
+    host->EventFD = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    struct epoll_event event = {};
+    event.events = EPOLLIN;
+    bool added = host->EpollFD >= 0 && host->EventFD >= 0 &&
+                 epoll_ctl(host->EpollFD, EPOLL_CTL_ADD, host->EventFD,
+                           &event) == 0;
+
+    // Jobs waiting on descriptors are released by polling the reactor,
+    // so the event loop must also wake up when it has events.
+    auto reactorFD = getReactor()->getFileDescriptor();
+    if (added && reactorFD >= 0)
+      added = epoll_ctl(host->EpollFD, EPOLL_CTL_ADD, reactorFD, &event) == 0;
+    if (!added) {
+      if (host->EpollFD >= 0) close(host->EpollFD);
+      if (host->EventFD >= 0) close(host->EventFD);
+      host->EpollFD = host->EventFD = -1;
+      return host;
+    }
+    host->IsArmed.store(true, std::memory_order_relaxed);
+    Host.store(host, std::memory_order_release);
+    return host;
+  }();
+  return host->EpollFD;
+#else
+  return -1;
+#endif
+}
+
+uint64_t my_swift::getGlobalExecutorTimeout() {
+  if (getTotalQueueDepth())
+    return 0;
+  auto nextTick = NextTimerTick.load(std::memory_order_acquire);
+  if (nextTick == UINT64_MAX)
+    return UINT64_MAX;
+  auto deadline = nextTick << TimerTickShift;
+  auto now = getCurrentNanos();
+  return deadline > now ? deadline - now : 0;
+}
+
+void my_swift::donateThreadToGlobalExecutorUntil(bool (*condition)(void *),
+                                              void *conditionContext) {
+  if (UseDispatch) {
+    // Dispatch runs the jobs.  Enqueue the ones that timers and I/O
+    // release until the condition is satisfied.
+    while (!condition(conditionContext)) {
+      if (!pollEventSources())
+        parkUntilWorkOrEvent([&] { return condition(conditionContext); });
+    }
+    return;
+  }
+
+  unsigned jobsSinceEventCheck = 0;
+  if (UseWorkerPool) {
+    // Help the workers until the condition is satisfied.
+    while (!condition(conditionContext)) {
+      if (++jobsSinceEventCheck == EventCheckInterval) {
+        pollEventSources();
+        jobsSinceEventCheck = 0;
+      }
+      if (auto job = claimNextForWorker(CurrentWorker.get()))
+        runJob(job);
+      else if (!pollEventSources())
+        waitForWork(CurrentWorker.get(), condition, conditionContext);
+    }
+    return;
+  }
+
+  IsDrainingThread.set(true);
+  while (!condition(conditionContext)) {
+    if (++jobsSinceEventCheck == EventCheckInterval) {
+      pollEventSources();
+      jobsSinceEventCheck = 0;
+    }
+    if (auto job = claimNextForDrainingThread()) {
+      runJob(job);
+      continue;
+    }
+    if (pollEventSources())
+      continue;
+
+    // Everything left to do is waiting on some other thread, e.g. a
+    // continuation that will be resumed from a Dispatch queue, on a
+    // timer, or on I/O.  Sleep until one of them enqueues a job.
+    parkUntilWorkOrEvent([&] {
+      return !ForeignJobQueue.isEmpty() || condition(conditionContext);
+    });
   }
+  flushNextJob();
+  IsDrainingThread.set(false);
 }
@@ -0,0 +1,301 @@
+//===--- IOUring.h - io_uring submission and completion rings ---*- C++ -*-===//
+//
+// A minimal io_uring wrapper for the global executor.  Submissions are
+// queued in the shared ring and handed to the kernel in batches, and
+// completions are reaped without a system call.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef SWIFT_CONCURRENCY_IOURING_H
+#define SWIFT_CONCURRENCY_IOURING_H
+
+#include "TaskPrivate.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define SWIFT_CONCURRENCY_HAS_IO_URING 1
+#else
+#define SWIFT_CONCURRENCY_HAS_IO_URING 0
+#endif
+
+namespace my_swift {
+
+/// An io_uring instance shared by the threads of the global executor.
+///
+/// Any thread may submit; submissions only become visible to the kernel
+/// when some thread calls flush(), so that operations submitted during
+/// one drain iteration cost a single io_uring_enter.  Any thread may
+/// reap completions.  Both sides are guarded by their own lock.
+class IOUring {
+#if SWIFT_CONCURRENCY_HAS_IO_URING
+  int RingFD = -1;
+
+  void *SQRing = nullptr;
+  size_t SQRingSize = 0;
+  void *CQRing = nullptr;
+  size_t CQRingSize = 0;
+  struct io_uring_sqe *SQEs = nullptr;
+  size_t SQEsSize = 0;
+
+  uint32_t *SQHead, *SQTail, *SQMask, *SQArray;
+  uint32_t *CQHead, *CQTail, *CQMask;
+  struct io_uring_cqe *CQEs;
+  uint32_t SQEntries = 0, CQEntries = 0;
+
+  /// Guards the submission queue and Unsubmitted.
+  std::mutex SubmitLock;
+
+  /// Entries written to the submission queue but not yet handed to the
+  /// kernel.
+  uint32_t Unsubmitted = 0;
+
+  /// Guards the completion queue.
+  std::mutex ReapLock;
+#endif
+
+  /// Operations submitted and not yet reaped.
+  std::atomic<uint32_t> InFlight{0};
+
+#if SWIFT_CONCURRENCY_HAS_IO_URING
+  template <class T>
+  static T *at(void *base, uint32_t offset) {
+    return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+  }
+
+  int enter(uint32_t toSubmit, uint32_t minComplete, uint32_t flags) {
+    return int(syscall(__NR_io_uring_enter, RingFD, toSubmit, minComplete,
+                       flags, nullptr, 0));
+  }
+
+  /// Check that the kernel supports every operation we submit.
+  bool probeOperations() {
+    const size_t numOps = 256;
+    size_t size = sizeof(struct io_uring_probe) +
+                  numOps * sizeof(struct io_uring_probe_op);
+    auto probe = static_cast<struct io_uring_probe*>(calloc(1, size));
+    if (!probe)
+      return false;
+    bool supported = false;
+    if (syscall(__NR_io_uring_register, RingFD, IORING_REGISTER_PROBE,
+                probe, numOps) == 0) {
+      auto isSupported = [&](unsigned op) {
+        return op <= probe->last_op &&
+               (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+      };
+      supported = isSupported(IORING_OP_READ) &&
+                  isSupported(IORING_OP_WRITE) &&
+                  isSupported(IORING_OP_ACCEPT) &&
+                  isSupported(IORING_OP_FSYNC);
+    }
+    free(probe);
+    return supported;
+  }
+
+  bool setUp(uint32_t entries) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    RingFD = int(syscall(__NR_io_uring_setup, entries, &params));
+    if (RingFD < 0)
+      return false;
+    if (!(params.features & IORING_FEAT_NODROP) || !probeOperations())
+      return false;
+
+    SQRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    CQRingSize = params.cq_off.cqes +
+                 params.cq_entries * sizeof(struct io_uring_cqe);
+    bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMap)
+      SQRingSize = CQRingSize = std::max(SQRingSize, CQRingSize);
+
+    SQRing = mmap(nullptr, SQRingSize, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, RingFD, IORING_OFF_SQ_RING);
+    if (SQRing == MAP_FAILED)
+      return false;
+    if (singleMap) {
+      CQRing = SQRing;
+    } else {
+      CQRing = mmap(nullptr, CQRingSize, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, RingFD, IORING_OFF_CQ_RING);
+      if (CQRing == MAP_FAILED)
+        return false;
+    }
+    SQEsSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    SQEs = static_cast<struct io_uring_sqe*>(
+        mmap(nullptr, SQEsSize, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_POPULATE, RingFD, IORING_OFF_SQES));
+    if (SQEs == MAP_FAILED)
+      return false;
+
+    SQHead = at<uint32_t>(SQRing, params.sq_off.head);
+    SQTail = at<uint32_t>(SQRing, params.sq_off.tail);
+    SQMask = at<uint32_t>(SQRing, params.sq_off.ring_mask);
+    SQArray = at<uint32_t>(SQRing, params.sq_off.array);
+    CQHead = at<uint32_t>(CQRing, params.cq_off.head);
+    CQTail = at<uint32_t>(CQRing, params.cq_off.tail);
+    CQMask = at<uint32_t>(CQRing, params.cq_off.ring_mask);
+    CQEs = at<struct io_uring_cqe>(CQRing, params.cq_off.cqes);
+    SQEntries = params.sq_entries;
+    CQEntries = params.cq_entries;
+    return true;
+  }
+
+  void tearDown() {
+    if (SQEs && SQEs != MAP_FAILED) munmap(SQEs, SQEsSize);
+    if (CQRing && CQRing != MAP_FAILED && CQRing != SQRing)
+      munmap(CQRing, CQRingSize);
+    if (SQRing && SQRing != MAP_FAILED) munmap(SQRing, SQRingSize);
+    if (RingFD >= 0) close(RingFD);
+    RingFD = -1;
+  }
+
+  /// Hand the unsubmitted entries to the kernel.  The caller must hold
+  /// SubmitLock.
+  void flushLocked() {
+    while (Unsubmitted) {
+      int submitted = enter(Unsubmitted, 0, 0);
+      if (submitted < 0) {
+        if (errno == EINTR)
+          continue;
+        // EAGAIN or EBUSY: the kernel is out of resources for now, so
+        // try again with the next flush.
+        return;
+      }
+      Unsubmitted -= uint32_t(submitted);
+    }
+  }
+#endif
+
+public:
+  explicit IOUring(uint32_t entries) {
+#if SWIFT_CONCURRENCY_HAS_IO_URING
+    if (!setUp(entries))
+      tearDown();
+#endif
+  }
+
+  IOUring(const IOUring &) = delete;
+  IOUring &operator=(const IOUring &) = delete;
+
+  bool isAvailable() const {
+#if SWIFT_CONCURRENCY_HAS_IO_URING
+    return RingFD >= 0;
+#else
+    return false;
+#endif
+  }
+
+  /// A descriptor that polls readable whenever completions are waiting
+  /// to be reaped.
+  int getFileDescriptor() const {
+#if SWIFT_CONCURRENCY_HAS_IO_URING
+    return RingFD;
+#else
+    return -1;
+#endif
+  }
+
+  bool hasInFlight() const {
+    return InFlight.load(std::memory_order_acquire) != 0;
+  }
+
+  /// Queue an operation whose completion will be reported with
+  /// \p userData.  Returns false if the ring is unavailable or already
+  /// has as many operations in flight as its completion queue holds.
+  bool submit(IOOperation operation, int fd, void *buffer, uint32_t length,
+              uint64_t offset, void *userData) {
+#if SWIFT_CONCURRENCY_HAS_IO_URING
+    if (!isAvailable())
+      return false;
+    std::lock_guard<std::mutex> guard(SubmitLock);
+    if (InFlight.load(std::memory_order_relaxed) >= CQEntries)
+      return false;
+
+    auto tail = *SQTail;
+    auto head = __atomic_load_n(SQHead, __ATOMIC_ACQUIRE);
+    if (tail - head == SQEntries) {
+      flushLocked();
+      head = __atomic_load_n(SQHead, __ATOMIC_ACQUIRE);
+      if (tail - head == SQEntries)
+        return false;
+    }
+
+    auto index = tail & *SQMask;
+    auto sqe = &SQEs[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->fd = fd;
+    sqe->user_data = reinterpret_cast<uint64_t>(userData);
+    switch (operation) {
+    case IOOperation::Read:
+    case IOOperation::Write:
+      sqe->opcode = operation == IOOperation::Read ? IORING_OP_READ
+                                                   : IORING_OP_WRITE;
+      sqe->addr = reinterpret_cast<uint64_t>(buffer);
+      sqe->len = length;
+      sqe->off = offset;
+      break;
+    case IOOperation::Accept:
+      sqe->opcode = IORING_OP_ACCEPT;
+      sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+      break;
+    case IOOperation::Fsync:
+      sqe->opcode = IORING_OP_FSYNC;
+      break;
+    }
+    SQArray[index] = index;
+    __atomic_store_n(SQTail, tail + 1, __ATOMIC_RELEASE);
+    ++Unsubmitted;
+    InFlight.fetch_add(1, std::memory_order_relaxed);
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  /// Hand every queued submission to the kernel with one system call.
+  void flush() {
+#if SWIFT_CONCURRENCY_HAS_IO_URING
+    if (!isAvailable())
+      return;
+    std::lock_guard<std::mutex> guard(SubmitLock);
+    flushLocked();
+#endif
+  }
+
+  /// Call \p completed with the user data and result of every completed
+  /// operation.  If another thread is already reaping, return at once.
+  template <class Fn>
+  void reap(Fn completed) {
+#if SWIFT_CONCURRENCY_HAS_IO_URING
+    if (!hasInFlight())
+      return;
+    std::unique_lock<std::mutex> guard(ReapLock, std::try_to_lock);
+    if (!guard.owns_lock())
+      return;
+    auto head = *CQHead;
+    auto tail = __atomic_load_n(CQTail, __ATOMIC_ACQUIRE);
+    if (head == tail)
+      return;
+    for (; head != tail; ++head) {
+      auto &cqe = CQEs[head & *CQMask];
+      completed(reinterpret_cast<void*>(cqe.user_data), cqe.res);
+    }
+    InFlight.fetch_sub(tail - *CQHead, std::memory_order_relaxed);
+    __atomic_store_n(CQHead, head, __ATOMIC_RELEASE);
+#endif
+  }
+};
+
+} // end namespace my_swift
+
+#endif
@@ -0,0 +1,101 @@
+//===--- InjectionQueue.h - Lock-free MPSC queue of jobs --------*- C++ -*-===//
+//
+// The queue through which threads other than the ones running the global
+// executor hand it jobs.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef SWIFT_CONCURRENCY_INJECTIONQUEUE_H
+#define SWIFT_CONCURRENCY_INJECTIONQUEUE_H
+
+#include "swift/ABI/Task.h"
+#include "swift/Runtime/Debug.h"
+#include "TaskPrivate.h"
+#include <atomic>
+
+namespace my_swift {
+
+/// A lock-free multi-producer, single-consumer queue of jobs enqueued
+/// from threads other than the one draining the global executor.
+///
+/// This is the intrusive queue described by Dmitry Vyukov: producers
+/// publish a job with a single atomic exchange on Head and then link
+/// it behind its predecessor, and the consumer walks the links from
+/// Tail.  A stub job keeps the queue non-empty so that the consumer
+/// never has to race producers for the last element.
+class InjectionQueue {
+  std::atomic<swift::Job*> Head;
+  swift::Job *Tail;
+  swift::Job Stub;
+
+  SWIFT_CC(swiftasync)
+  static void runStub(swift::Job *job, swift::ExecutorRef executor) {
+    swift_unreachable("ran the injection queue stub job");
+  }
+
+  static std::atomic<swift::Job*> &nextInInjectionQueue(swift::Job *job) {
+    return reinterpret_cast<std::atomic<swift::Job*>&>(
+        job->SchedulerPrivate[0]);
+  }
+
+public:
+  InjectionQueue()
+    : Head(&Stub), Tail(&Stub),
+      Stub(swift::JobFlags(
+               getJobKind(LibraryJobKind::InjectionQueueStub)),
+           &runStub) {
+    nextInInjectionQueue(&Stub).store(nullptr, std::memory_order_relaxed);
+  }
+
+  /// Enqueue a job.  This can be called from any thread.
+  void push(swift::Job *job) {
+    nextInInjectionQueue(job).store(nullptr, std::memory_order_relaxed);
+    auto prev = Head.exchange(job, std::memory_order_acq_rel);
+    nextInInjectionQueue(prev).store(job, std::memory_order_release);
+  }
+
+  /// Enqueue a chain of jobs already linked through SchedulerPrivate[0],
+  /// with the same single atomic exchange as push.
+  void pushChain(swift::Job *first, swift::Job *last) {
+    nextInInjectionQueue(last).store(nullptr, std::memory_order_relaxed);
+    auto prev = Head.exchange(last, std::memory_order_acq_rel);
+    nextInInjectionQueue(prev).store(first, std::memory_order_release);
+  }
+
+  /// Is the queue empty?  This can be called from any thread, but the
+  /// answer may of course be stale by the time it is used.
+  bool isEmpty() const {
+    return Head.load(std::memory_order_acquire) == &Stub;
+  }
+
+  /// Dequeue the oldest job, or return null if the queue is empty or a
+  /// producer has not yet finished linking the next job.  This must only
+  /// be called by the draining thread.
+  swift::Job *pop() {
+    auto tail = Tail;
+    auto next = nextInInjectionQueue(tail).load(std::memory_order_acquire);
+    if (tail == &Stub) {
+      if (!next) return nullptr;
+      Tail = next;
+      tail = next;
+      next = nextInInjectionQueue(next).load(std::memory_order_acquire);
+    }
+    if (next) {
+      Tail = next;
+      return tail;
+    }
+    if (tail != Head.load(std::memory_order_acquire))
+      return nullptr;
+    push(&Stub);
+    next = nextInInjectionQueue(tail).load(std::memory_order_acquire);
+    if (next) {
+      Tail = next;
+      return tail;
+    }
+    return nullptr;
+  }
+};
+
+} // end namespace my_swift
+
+#endif
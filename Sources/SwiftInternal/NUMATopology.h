@@ -0,0 +1,109 @@
+//===--- NUMATopology.h - NUMA nodes for worker placement -------*- C++ -*-===//
+//
+// Reads the machine's NUMA nodes and their CPUs from sysfs, so that the
+// global executor can keep each worker, and the memory it touches, on
+// one node.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef SWIFT_CONCURRENCY_NUMATOPOLOGY_H
+#define SWIFT_CONCURRENCY_NUMATOPOLOGY_H
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <dirent.h>
+#include <sched.h>
+#endif
+
+namespace my_swift {
+
+/// A NUMA node and the CPUs on it that the process may run on.
+struct NUMANode {
+  unsigned ID;
+  std::vector<unsigned> CPUs;
+};
+
+/// Parse a sysfs CPU list, such as "0-3,8-11", appending the CPUs to
+/// \p cpus.  Returns false if the text is malformed.
+inline bool parseCPUList(const char *text, std::vector<unsigned> &cpus) {
+  while (*text && *text != '\n') {
+    char *end;
+    auto first = strtoul(text, &end, 10);
+    if (end == text)
+      return false;
+    auto last = first;
+    text = end;
+    if (*text == '-') {
+      ++text;
+      last = strtoul(text, &end, 10);
+      if (end == text || last < first)
+        return false;
+      text = end;
+    }
+    for (auto cpu = first; cpu <= last; ++cpu)
+      cpus.push_back(unsigned(cpu));
+    if (*text == ',')
+      ++text;
+    else if (*text && *text != '\n')
+      return false;
+  }
+  return true;
+}
+
+/// Read the NUMA nodes under \p root, ordered by ID, keeping only the
+/// CPUs in the process's affinity mask and only the nodes that have any.
+/// Returns an empty list if the topology cannot be read, e.g. because
+/// this is not Linux.
+inline std::vector<NUMANode>
+readNUMATopology(const char *root = "/sys/devices/system/node") {
+  std::vector<NUMANode> nodes;
+#if defined(__linux__)
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+    return nodes;
+
+  auto dir = opendir(root);
+  if (!dir)
+    return nodes;
+  while (auto entry = readdir(dir)) {
+    unsigned id;
+    char trailing;
+    if (sscanf(entry->d_name, "node%u%c", &id, &trailing) != 1)
+      continue;
+
+    auto path = std::string(root) + "/" + entry->d_name + "/cpulist";
+    auto file = fopen(path.c_str(), "r");
+    if (!file)
+      continue;
+    char text[4096];
+    std::vector<unsigned> cpus;
+    bool parsed = fgets(text, sizeof(text), file) && parseCPUList(text, cpus);
+    fclose(file);
+    if (!parsed)
+      continue;
+
+    NUMANode node{id, {}};
+    for (auto cpu : cpus)
+      if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed))
+        node.CPUs.push_back(cpu);
+    if (!node.CPUs.empty())
+      nodes.push_back(std::move(node));
+  }
+  closedir(dir);
+
+  std::sort(nodes.begin(), nodes.end(),
+            [](const NUMANode &a, const NUMANode &b) { return a.ID < b.ID; });
+#endif
+  return nodes;
+}
+
+} // end namespace my_swift
+
+#endif
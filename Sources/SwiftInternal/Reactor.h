@@ -0,0 +1,288 @@
+//===--- Reactor.h - File descriptor readiness for the executor -*- C++ -*-===//
+//
+// An epoll-based reactor that hands jobs back once the file descriptor
+// they are waiting on becomes readable or writable.  It has no thread of
+// its own: idle executor threads block in it, and busy ones poll it.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef SWIFT_CONCURRENCY_REACTOR_H
+#define SWIFT_CONCURRENCY_REACTOR_H
+
+#include "swift/ABI/Task.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+namespace my_swift {
+
+/// Waits for file descriptors to become ready, on behalf of jobs.
+///
+/// Each file descriptor is registered with epoll once, in one-shot mode,
+/// and re-armed with the union of the directions that still have
+/// waiters every time a job starts waiting or an event is delivered.
+/// Jobs waiting in the same direction on the same descriptor are linked
+/// through SchedulerPrivate[0] and are all released together.
+///
+/// A hangup or error releases the waiters of both directions, and so
+/// does a descriptor that can no longer be re-armed, e.g. because it was
+/// closed.  Closing a descriptor removes it from the epoll set without
+/// an event, so whoever closes one that jobs may be waiting on must call
+/// unwatch() first.
+///
+/// One thread at a time may block in the reactor; interrupt() wakes it.
+class Reactor {
+  struct Interest {
+    swift::Job *Readers = nullptr;
+    swift::Job *Writers = nullptr;
+    bool IsRegistered = false;
+  };
+
+  int EpollFD = -1;
+  int WakeFD = -1;
+
+  /// Guards Interests.
+  std::mutex Lock;
+
+  /// Indexed by file descriptor.
+  std::vector<Interest> Interests;
+
+  std::atomic<size_t> NumWaiters{0};
+
+  /// Whether a thread is blocked in the reactor and must be interrupted
+  /// to notice new work.
+  std::atomic<bool> IsBlocked{false};
+
+  static swift::Job *&nextWaiter(swift::Job *job) {
+    return reinterpret_cast<swift::Job*&>(job->SchedulerPrivate[0]);
+  }
+
+#if defined(__linux__)
+  static uint32_t getEpollEvents(const Interest &interest) {
+    uint32_t events = EPOLLONESHOT;
+    if (interest.Readers)
+      events |= EPOLLIN | EPOLLRDHUP;
+    if (interest.Writers)
+      events |= EPOLLOUT;
+    return events;
+  }
+
+  /// Arm epoll for the directions that have waiters.  The caller must
+  /// hold Lock.
+  bool arm(int fd, Interest &interest) {
+    struct epoll_event event = {};
+    event.events = getEpollEvents(interest);
+    event.data.fd = fd;
+    if (interest.IsRegistered) {
+      if (epoll_ctl(EpollFD, EPOLL_CTL_MOD, fd, &event) == 0)
+        return true;
+      // The descriptor was closed, and maybe reopened, since we last
+      // saw it, which silently removed it from the epoll set.
+      if (errno != ENOENT)
+        return false;
+    }
+    if (epoll_ctl(EpollFD, EPOLL_CTL_ADD, fd, &event) != 0)
+      return false;
+    interest.IsRegistered = true;
+    return true;
+  }
+
+  template <class Fn>
+  void waitAndDeliver(int timeoutMillis, bool isBlocking, Fn &ready) {
+    struct epoll_event events[64];
+    int count = epoll_wait(EpollFD, events, 64, timeoutMillis);
+    for (int i = 0; i < count; ++i) {
+      auto fd = events[i].data.fd;
+      if (fd == WakeFD) {
+        // Only the blocking thread may consume an interrupt.  If a thread
+        // that is merely polling took it, the blocking thread, which
+        // epoll woke for the same event, would find nothing to report
+        // and go back to sleep.
+        if (isBlocking) {
+          uint64_t value;
+          (void)read(WakeFD, &value, sizeof(value));
+        }
+        continue;
+      }
+      deliver(fd, events[i].events, ready);
+    }
+  }
+
+  /// Release the waiters that \p events satisfies and re-arm the rest,
+  /// or release them too if the descriptor cannot be re-armed.
+  template <class Fn>
+  void deliver(int fd, uint32_t events, Fn &ready) {
+    swift::Job *released[4] = {};
+    {
+      std::lock_guard<std::mutex> guard(Lock);
+      auto &interest = Interests[fd];
+      if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+        std::swap(released[0], interest.Readers);
+      if (events & (EPOLLOUT | EPOLLHUP | EPOLLERR))
+        std::swap(released[1], interest.Writers);
+      if ((interest.Readers || interest.Writers) && !arm(fd, interest)) {
+        std::swap(released[2], interest.Readers);
+        std::swap(released[3], interest.Writers);
+        interest.IsRegistered = false;
+      }
+    }
+    release(released, ready);
+  }
+
+  /// Hand back every job in the lists of waiters \p released.
+  template <size_t N, class Fn>
+  void release(swift::Job *(&released)[N], Fn &ready) {
+    for (auto job : released) {
+      while (job) {
+        auto next = nextWaiter(job);
+        NumWaiters.fetch_sub(1, std::memory_order_relaxed);
+        ready(job);
+        job = next;
+      }
+    }
+  }
+#endif
+
+public:
+  Reactor() {
+#if defined(__linux__)
+    EpollFD = epoll_create1(EPOLL_CLOEXEC);
+    WakeFD = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    struct epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = WakeFD;
+    if (EpollFD < 0 || WakeFD < 0 ||
+        epoll_ctl(EpollFD, EPOLL_CTL_ADD, WakeFD, &event) != 0) {
+      if (EpollFD >= 0) close(EpollFD);
+      if (WakeFD >= 0) close(WakeFD);
+      EpollFD = WakeFD = -1;
+    }
+#endif
+  }
+
+  Reactor(const Reactor &) = delete;
+  Reactor &operator=(const Reactor &) = delete;
+
+  bool isAvailable() const { return EpollFD >= 0; }
+
+  /// A descriptor that polls readable whenever a descriptor that a job
+  /// is waiting on is ready, or -1 if the reactor is not available.
+  int getFileDescriptor() const { return EpollFD; }
+
+  bool hasWaiters() const {
+    return NumWaiters.load(std::memory_order_relaxed) != 0;
+  }
+
+  /// Hand \p job back from poll() or block() once \p fd is ready for reading, or
+  /// for writing if \p forWriting.  Returns false if the descriptor
+  /// cannot be waited on, e.g. because it is a regular file, which is
+  /// always ready.
+  bool watch(swift::Job *job, int fd, bool forWriting) {
+#if defined(__linux__)
+    if (!isAvailable() || fd < 0)
+      return false;
+    std::lock_guard<std::mutex> guard(Lock);
+    if (size_t(fd) >= Interests.size())
+      Interests.resize(size_t(fd) + 1);
+    auto &interest = Interests[fd];
+    auto &waiters = forWriting ? interest.Writers : interest.Readers;
+    nextWaiter(job) = waiters;
+    waiters = job;
+    if (!arm(fd, interest)) {
+      waiters = nextWaiter(job);
+      return false;
+    }
+    NumWaiters.fetch_add(1, std::memory_order_relaxed);
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  /// Stop watching \p fd and call \p ready with every job waiting on it,
+  /// which then finds out for itself that the descriptor is gone.  Call
+  /// this before closing a descriptor that jobs may be waiting on.
+  template <class Fn>
+  void unwatch(int fd, Fn ready) {
+#if defined(__linux__)
+    swift::Job *released[2] = {};
+    {
+      std::lock_guard<std::mutex> guard(Lock);
+      if (fd < 0 || size_t(fd) >= Interests.size())
+        return;
+      auto &interest = Interests[fd];
+      std::swap(released[0], interest.Readers);
+      std::swap(released[1], interest.Writers);
+      if (interest.IsRegistered) {
+        // This fails harmlessly with EBADF or ENOENT if the descriptor
+        // has been closed already.
+        (void)epoll_ctl(EpollFD, EPOLL_CTL_DEL, fd, nullptr);
+        interest.IsRegistered = false;
+      }
+    }
+    release(released, ready);
+#endif
+  }
+
+  bool isBlocked() const {
+    return IsBlocked.load(std::memory_order_relaxed);
+  }
+
+  /// Call \p ready with each job whose descriptor is ready now, without
+  /// blocking.  This can be called from any thread.
+  template <class Fn>
+  void poll(Fn ready) {
+#if defined(__linux__)
+    waitAndDeliver(0, /*isBlocking*/ false, ready);
+#endif
+  }
+
+  /// Block until a descriptor that a job is waiting on becomes ready,
+  /// interrupt() is called, or \p timeoutNanos pass (never, if it is
+  /// UINT64_MAX), and then call \p ready with each job that was released.
+  /// Only one thread at a time may block.  \p isReady is checked after
+  /// the thread has announced itself to interrupt(), so that no work
+  /// published concurrently is missed.
+  template <class Cond, class Fn>
+  void block(uint64_t timeoutNanos, Cond isReady, Fn ready) {
+#if defined(__linux__)
+    IsBlocked.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int timeoutMillis = -1;
+    if (timeoutNanos != UINT64_MAX)
+      timeoutMillis = int(std::min<uint64_t>((timeoutNanos + 999999) / 1000000,
+                                             INT32_MAX));
+    if (isReady())
+      timeoutMillis = 0;
+    waitAndDeliver(timeoutMillis, /*isBlocking*/ true, ready);
+    IsBlocked.store(false, std::memory_order_relaxed);
+#endif
+  }
+
+  /// Wake up the thread blocked in the reactor, if any.  Call this after
+  /// publishing work.
+  void interrupt() {
+#if defined(__linux__)
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (IsBlocked.load(std::memory_order_relaxed) &&
+        IsBlocked.exchange(false, std::memory_order_relaxed)) {
+      uint64_t one = 1;
+      (void)write(WakeFD, &one, sizeof(one));
+    }
+#endif
+  }
+};
+
+} // end namespace my_swift
+
+#endif
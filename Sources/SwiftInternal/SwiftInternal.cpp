@@ -1,16 +1,259 @@
 #include "swift/Runtime/Concurrency.h"
+#include "TaskPrivate.h"
+#include "DedicatedThreadExecutor.h"
+#include "FairQueue.h"
+#include <algorithm>
+#include <climits>
 #include <iostream>
 
+extern "C" {
+#include "SwiftInternal.h"
+}
+
 using namespace swift;
 void insertIntoJobQueue(Job *newJob);
+void insertBatchIntoJobQueue(Job **jobs, size_t count);
+void requeueEscalatedJob(Job *job, JobPriority newPriority);
 
 SWIFT_CC(swift)
 static void enqueueGlobal(Job *job) {
-    printf("enqueueGlobal\n");
     insertIntoJobQueue(job);
 }
 
+extern "C" void swiftEnqueueGlobalBatch(Job **jobs, size_t count) {
+    insertBatchIntoJobQueue(jobs, count);
+}
+
+SWIFT_CC(swift)
+static void escalateGlobal(Job *job, JobPriority newPriority) {
+    requeueEscalatedJob(job, newPriority);
+}
+
+extern "C" void swiftSetMailboxDrainQuantum(size_t maxJobs,
+                                            uint64_t maxNanos) {
+    my_swift::setMailboxDrainQuantum(maxJobs, maxNanos);
+}
+
+extern "C" void swiftSetMailboxInlineDrainEnabled(bool enabled) {
+    my_swift::setMailboxInlineDrainEnabled(enabled);
+}
+
+extern "C" void swiftSetWorkerAffinityThreshold(size_t maxQueuedJobs) {
+    my_swift::setWorkerAffinityThreshold(maxQueuedJobs);
+}
+
+static my_swift::DedicatedThreadExecutor *
+getDedicatedExecutor(SwiftDedicatedExecutor *executor) {
+    return reinterpret_cast<my_swift::DedicatedThreadExecutor *>(executor);
+}
+
+extern "C" SwiftDedicatedExecutor *
+swiftCreateDedicatedExecutor(const uint32_t *cpus, size_t numCPUs,
+                             bool interactive) {
+    auto executor = new my_swift::DedicatedThreadExecutor(
+        interactive ? JobPriority::UserInteractive : JobPriority::Default,
+        std::vector<unsigned>(cpus, cpus + numCPUs));
+    return reinterpret_cast<SwiftDedicatedExecutor *>(executor);
+}
+
+extern "C" void swiftDestroyDedicatedExecutor(SwiftDedicatedExecutor *executor) {
+    delete getDedicatedExecutor(executor);
+}
+
+extern "C" void swiftRunOnDedicatedExecutor(SwiftDedicatedExecutor *executor,
+                                            void (*work)(void *),
+                                            void *context) {
+    auto dedicated = getDedicatedExecutor(executor);
+    my_swift::enqueueCallbackOnExecutor(dedicated,
+                                        dedicated->getPriorityHint(), work,
+                                        context);
+}
+
+extern "C" bool swiftIsOnDedicatedExecutor(SwiftDedicatedExecutor *executor) {
+    return getDedicatedExecutor(executor)->isCurrent();
+}
+
+static my_swift::SerialExecutor *
+getMailboxExecutor(SwiftMailboxExecutor *executor) {
+    return reinterpret_cast<my_swift::SerialExecutor *>(executor);
+}
+
+extern "C" SwiftMailboxExecutor *swiftCreateMailboxExecutor(void) {
+    return reinterpret_cast<SwiftMailboxExecutor *>(
+        my_swift::createMailboxExecutor());
+}
+
+extern "C" void swiftDestroyMailboxExecutor(SwiftMailboxExecutor *executor) {
+    my_swift::destroyMailboxExecutor(getMailboxExecutor(executor));
+}
+
+extern "C" void swiftRunOnMailboxExecutor(SwiftMailboxExecutor *executor,
+                                          void (*work)(void *),
+                                          void *context) {
+    auto mailbox = getMailboxExecutor(executor);
+    my_swift::enqueueCallbackOnExecutor(mailbox, mailbox->getPriorityHint(),
+                                        work, context);
+}
+
+extern "C" bool swiftIsOnMailboxExecutor(SwiftMailboxExecutor *executor) {
+    return getMailboxExecutor(executor)->isCurrent();
+}
+
 extern "C" void swiftInstallConcurrencyEnqueueHook(void) {
     swift_task_enqueueGlobal_hook = enqueueGlobal;
+    my_swift::swift_task_escalateGlobal_hook = escalateGlobal;
+}
+
+extern "C" void swiftInstallConcurrencyEnqueueHookWithWorkers(size_t numWorkers) {
+    my_swift::startGlobalExecutorWorkers(
+        unsigned(std::min<size_t>(numWorkers, UINT_MAX)));
+    swift_task_enqueueGlobal_hook = enqueueGlobal;
+    my_swift::swift_task_escalateGlobal_hook = escalateGlobal;
+}
+
+extern "C" void swiftSetNUMAPlacementEnabled(bool enabled) {
+    my_swift::setNUMAPlacementEnabled(enabled);
 }
 
+extern "C" void swiftInstallConcurrencyEnqueueHookWithWorkerBands(
+        size_t numBackground, size_t numDefault, size_t numInteractive,
+        bool realtimeInteractive) {
+    const unsigned numWorkers[my_swift::NumWorkerBands] = {
+        unsigned(std::min<size_t>(numBackground, UINT_MAX)),
+        unsigned(std::min<size_t>(numDefault, UINT_MAX)),
+        unsigned(std::min<size_t>(numInteractive, UINT_MAX)),
+    };
+    my_swift::startGlobalExecutorBands(numWorkers, realtimeInteractive);
+    swift_task_enqueueGlobal_hook = enqueueGlobal;
+    my_swift::swift_task_escalateGlobal_hook = escalateGlobal;
+}
+
+extern "C" bool swiftInstallConcurrencyEnqueueHookWithDispatch(void) {
+    bool started = my_swift::startGlobalExecutorOnDispatch();
+    swift_task_enqueueGlobal_hook = enqueueGlobal;
+    my_swift::swift_task_escalateGlobal_hook = escalateGlobal;
+    return started;
+}
+
+extern "C" size_t swiftExecutorRunFor(uint64_t maxNanos, size_t maxJobs) {
+    return my_swift::runGlobalExecutorFor(maxNanos, maxJobs);
+}
+
+extern "C" int swiftExecutorGetWakeFD(void) {
+    return my_swift::getGlobalExecutorWakeFD();
+}
+
+extern "C" uint64_t swiftExecutorGetTimeout(void) {
+    return my_swift::getGlobalExecutorTimeout();
+}
+
+extern "C" void swiftSetDeadlineSchedulingEnabled(bool enabled) {
+    my_swift::setDeadlineSchedulingEnabled(enabled);
+}
+
+extern "C" void swiftSetPriorityAgingInterval(uint64_t intervalNanos) {
+    my_swift::setPriorityAgingInterval(intervalNanos);
+}
+
+extern "C" void swiftSetQueueStatisticsEnabled(bool enabled) {
+    my_swift::setQueueStatisticsEnabled(enabled);
+}
+
+extern "C" void swiftGetQueueStatistics(size_t level,
+                                        SwiftQueueWaitStatistics *stats) {
+    auto result = my_swift::getQueueStatistics(
+        unsigned(std::min<size_t>(level, UINT_MAX)));
+    stats->dequeued = result.Dequeued;
+    stats->agedDequeues = result.AgedDequeues;
+    stats->totalWaitNanos = result.TotalWaitNanos;
+    stats->maxWaitNanos = result.MaxWaitNanos;
+}
+
+extern "C" void swiftSetGlobalAdmissionPolicy(SwiftAdmissionPolicy policy,
+                                              size_t highWaterMark) {
+    my_swift::setGlobalAdmissionPolicy(my_swift::AdmissionPolicy(policy),
+                                       highWaterMark);
+}
+
+extern "C" size_t swiftGetGlobalQueueDepth(void) {
+    return my_swift::getGlobalQueueDepth();
+}
+
+extern "C" SwiftAdmissionResult swiftAdmitGlobalWork(uint8_t priority,
+                                                     void (*resume)(void *),
+                                                     void *context) {
+    return SwiftAdmissionResult(
+        my_swift::admitGlobalWork(JobPriority(priority), resume, context));
+}
+
+extern "C" void swiftSetTenantWeight(uint32_t tenant, uint32_t weight) {
+    if (tenant < my_swift::MaxTenants)
+        my_swift::setTenantWeight(tenant, weight);
+}
+
+extern "C" void *swiftBeginTenantScope(uint32_t tenant) {
+    auto task = dyn_cast_or_null<AsyncTask>(my_swift::getRunningJob());
+    if (!task)
+        return nullptr;
+    return my_swift::beginTenantScope(task, tenant);
+}
+
+extern "C" void swiftEndTenantScope(void *scope) {
+    my_swift::endTenantScope(static_cast<my_swift::TenantScope *>(scope));
+}
+
+extern "C" void swiftInheritPriority(void *task, uint8_t priority) {
+    my_swift::inheritPriority(static_cast<AsyncTask *>(task),
+                              JobPriority(priority));
+}
+
+extern "C" uint64_t swiftEnqueueGlobalAfter(Job *job, uint64_t delayNanos) {
+    return my_swift::enqueueGlobalAfter(job, delayNanos);
+}
+
+extern "C" Job *swiftCancelGlobalTimer(uint64_t timerID) {
+    return my_swift::cancelGlobalTimer(timerID);
+}
+
+extern "C" void swiftScheduleGlobalCallbackAfter(uint64_t delayNanos,
+                                                 void (*callback)(void *),
+                                                 void *context) {
+    my_swift::enqueueGlobalCallbackAfter(delayNanos, JobPriority::Default,
+                                         callback, context);
+}
+
+extern "C" void swiftEnqueueGlobalWhenReady(Job *job, int fd, bool forWriting) {
+    my_swift::enqueueGlobalWhenReady(job, fd, forWriting);
+}
+
+extern "C" void swiftScheduleGlobalCallbackWhenReady(int fd, bool forWriting,
+                                                     void (*callback)(void *),
+                                                     void *context) {
+    my_swift::enqueueGlobalCallbackWhenReady(fd, forWriting,
+                                             JobPriority::Default,
+                                             callback, context);
+}
+
+extern "C" void swiftUnwatchGlobalDescriptor(int fd) {
+    my_swift::unwatchGlobalDescriptor(fd);
+}
+
+extern "C" void swiftRunBlocking(void (*work)(void *), void *context) {
+    my_swift::runBlocking(work, context);
+}
+
+extern "C" void swiftSetBlockingPoolLimits(size_t maxThreads,
+                                           uint64_t idleTimeoutNanos) {
+    my_swift::setBlockingPoolLimits(
+        unsigned(std::min<size_t>(maxThreads, UINT_MAX)), idleTimeoutNanos);
+}
+
+extern "C" void swiftSubmitGlobalIO(SwiftIOOperation operation, int fd,
+                                    void *buffer, uint32_t length,
+                                    uint64_t offset,
+                                    void (*callback)(void *, int32_t),
+                                    void *context) {
+    my_swift::submitGlobalIO(my_swift::IOOperation(operation), fd, buffer,
+                             length, offset, JobPriority::Default,
+                             callback, context);
+}
@@ -36,18 +36,20 @@ struct ThickAsyncFunctionContext: HeapObject {
 #if SWIFT_CONCURRENCY_COOPERATIVE_GLOBAL_EXECUTOR
 
 class RunAndBlockSemaphore {
-  bool Finished = false;
+  std::atomic<bool> Finished{false};
 public:
   void wait() {
     my_swift::donateThreadToGlobalExecutorUntil([](void *context) {
-      return *reinterpret_cast<bool*>(context);
+      return reinterpret_cast<std::atomic<bool>*>(context)
+               ->load(std::memory_order_acquire);
     }, &Finished);
 
     assert(Finished && "ran out of tasks before we were signalled");
   }
 
   void signal() {
-    Finished = true;
+    Finished.store(true, std::memory_order_release);
+    my_swift::wakeGlobalExecutorThreads();
   }
 };
 
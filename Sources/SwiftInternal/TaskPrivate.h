@@ -23,11 +23,451 @@
 #include "swift/Runtime/HeapObject.h"
 
 namespace my_swift {
+using swift::JobPriority;
+
+/// The job kinds private to this library.  The runtime reserves the
+/// kinds from JobKind::First_Reserved through DefaultActorOverride for
+/// its own jobs, and may inspect them, so every job that this library
+/// builds itself takes one of the kinds after those, up to 255, from
+/// this list.
+enum class LibraryJobKind : size_t {
+  First = size_t(swift::JobKind::DefaultActorOverride) + 1,
+
+  /// A job of the global executor that calls back into C, such as a
+  /// CallbackJob or an IOJob.
+  Callback = First,
+
+  /// The job that drains a MailboxExecutor.
+  MailboxDrain,
+
+  /// The stub node of an InjectionQueue, which never runs.
+  InjectionQueueStub,
+};
+
+/// The JobKind for a job private to this library.
+constexpr swift::JobKind getJobKind(LibraryJobKind kind) {
+  return swift::JobKind(size_t(kind));
+}
+
 void donateThreadToGlobalExecutorUntil(bool (*condition)(void*),
                                        void *context);
 
+/// Enqueue \p count jobs on the global executor as if by
+/// swift_task_enqueueGlobal, but linking them by priority first and
+/// publishing them all with one synchronizing operation.
+extern "C" void swiftEnqueueGlobalBatch(swift::Job **jobs, size_t count);
+
+/// Start the global executor's worker pool with the given number of
+/// threads, or one per CPU if zero.  Once started, jobs run on the
+/// workers instead of on threads donated by
+/// donateThreadToGlobalExecutorUntil.  This must be called before any
+/// job is enqueued.
+void startGlobalExecutorWorkers(unsigned numWorkers);
+
+/// Pin the workers that startGlobalExecutorWorkers or
+/// startGlobalExecutorBands start to the NUMA nodes that the process may
+/// run on, in proportion to their CPUs, and have idle workers steal from
+/// workers on their own node first.  This has no effect on a machine with
+/// a single node.  It must be called before the workers are started.
+void setNUMAPlacementEnabled(bool enabled);
+
+/// The worker of the global executor's pool that the current thread is,
+/// as its index plus one, or 0 if the thread is not a pool worker.
+unsigned getCurrentGlobalWorker();
+
+/// Whether the current thread is running jobs for the global executor:
+/// a worker of its pool or, without a pool, the thread donated to drain
+/// it.
+bool isGlobalExecutorThread();
+
+/// Enqueue \p job on the global executor, preferring the local queues of
+/// the worker \p workerID, as returned by getCurrentGlobalWorker, so that
+/// the job finds the memory it works on in that worker's caches.  The job
+/// goes there only if the worker has fewer jobs queued than the affinity
+/// threshold and could run it locally; otherwise, and outside the worker
+/// pool, it goes on the global executor's queues.  Either way it goes
+/// behind the jobs already queued, never into the current thread's
+/// NextJob slot.  A parked worker is woken for it alone; if the worker is
+/// busy, an idle worker is woken and may steal the job.
+void enqueueGlobalOnWorker(swift::Job *job, unsigned workerID);
+
+/// Set how many jobs a worker may have queued and still be preferred by
+/// enqueueGlobalOnWorker, or 0 to turn the preference off.  The default
+/// is 8.
+void setWorkerAffinityThreshold(size_t maxQueuedJobs);
+
+/// The bands of priorities that startGlobalExecutorBands gives separate
+/// groups of workers.
+enum class WorkerBand : uint8_t {
+  /// Background and Utility jobs, on threads that run under SCHED_BATCH
+  /// at a raised nice value, so that they yield the CPU to the others.
+  Background,
+
+  /// Default and UserInitiated jobs, and those without a priority, on
+  /// ordinary threads.
+  Default,
+
+  /// UserInteractive jobs, on threads that run under SCHED_FIFO if that
+  /// was asked for and is permitted, and on ordinary threads otherwise.
+  Interactive,
+};
+
+enum : unsigned { NumWorkerBands = 3 };
+
+/// Start the worker pool with a separate group of workers for each
+/// band, of \p numWorkers[band] threads, or one if zero.  A band's
+/// threads only ever run its jobs, so they are reserved for it: a busy
+/// band cannot take threads from the others, and the OS scheduling
+/// class of each band's threads keeps background work from slowing
+/// foreground work down on shared cores.  \p realtimeInteractive asks
+/// for SCHED_FIFO for the Interactive band, which usually needs
+/// privileges; without them, the band runs at normal priority.
+///
+/// Like startGlobalExecutorWorkers, this must be called before any job is
+/// enqueued, and instead of it.
+void startGlobalExecutorBands(const unsigned (&numWorkers)[NumWorkerBands],
+                              bool realtimeInteractive);
+
+/// Run the global executor's jobs on libdispatch's global concurrent
+/// queues instead, each on the queue of the QoS class that matches its
+/// priority.  Dispatch orders and schedules its own queues, so deadline
+/// and tenant ordering, aging, queue statistics and the running thread's
+/// NextJob slot do not apply; admission control does.  Threads donated
+/// by donateThreadToGlobalExecutorUntil only wait for timers and I/O.
+/// Returns false, leaving the cooperative executor in place, if the
+/// library was built without Dispatch.  Like startGlobalExecutorWorkers,
+/// this must be called before any job is enqueued.
+bool startGlobalExecutorOnDispatch();
+
+/// Run jobs of the global executor on the current thread, and enqueue
+/// the jobs of expired timers and ready descriptors, for at most
+/// \p maxNanos nanoseconds or \p maxJobs jobs, where zero means no
+/// limit, or until there is nothing left to run.  Returns the number of
+/// jobs still queued.  This lets an event loop drive the executor in
+/// place of a donated thread.
+size_t runGlobalExecutorFor(uint64_t maxNanos, size_t maxJobs);
+
+/// A descriptor that polls readable once there may be work for
+/// runGlobalExecutorFor, for an event loop to wait on between calls, or
+/// -1 if there is none on this platform.  The descriptor belongs to the
+/// executor and must not be read or closed.
+int getGlobalExecutorWakeFD();
+
+/// How long the event loop may wait on getGlobalExecutorWakeFD before it
+/// must call runGlobalExecutorFor anyway, for the next timer: 0 if jobs
+/// are queued, or UINT64_MAX if nothing is pending.
+uint64_t getGlobalExecutorTimeout();
+
+/// Enable or disable earliest-deadline-first ordering of tasks that
+/// carry a DeadlineStatusRecord within their priority level.
+void setDeadlineSchedulingEnabled(bool enabled);
+
+/// What the global executor does about new work once the number of
+/// queued jobs reaches the high-water mark.
+enum class AdmissionPolicy : uint8_t {
+  /// Accept everything.
+  None,
+
+  /// Refuse new work: admitGlobalWork returns Rejected.
+  Reject,
+
+  /// Drop the lowest-priority work: admitGlobalWork admits new work by
+  /// cancelling a queued task of lower priority, which then winds down
+  /// as soon as it runs, and rejects it if there is none.
+  DropLowest,
+
+  /// Hold new work back: admitGlobalWork defers it until the queue has
+  /// drained to half the high-water mark.
+  Backpressure,
+};
+
+/// Set the admission policy and its high-water mark, in queued jobs.
+void setGlobalAdmissionPolicy(AdmissionPolicy policy, size_t highWaterMark);
+
+/// The number of jobs enqueued on the global executor that have not
+/// started running, in total or at the priority level of \p priority.
+size_t getGlobalQueueDepth();
+size_t getGlobalQueueDepth(JobPriority priority);
+
+enum class AdmissionResult : uint8_t {
+  Admitted,
+  Rejected,
+
+  /// The caller must wait for \p resume to be called before going on.
+  Deferred,
+};
+
+/// Ask whether new work of \p priority, such as a new task, may be
+/// started under the admission policy.  If the result is Deferred,
+/// \p resume will be called with \p context once it may, possibly right
+/// away on this thread.  Jobs that are already running or queued are
+/// never refused.
+AdmissionResult admitGlobalWork(JobPriority priority, void (*resume)(void *),
+                                void *context);
+
+class TenantScope;
+
+/// Give \p tenant a share of each priority level of the global executor
+/// in proportion to \p weight, relative to the other tenants with jobs
+/// at that level.  Jobs of tasks without a tenant count as tenant 0.
+/// Every tenant's weight starts out as 1.
+void setTenantWeight(unsigned tenant, uint32_t weight);
+
+/// Tag \p task, which must be the current task, with \p tenant, from 1
+/// to 63, until endTenantScope is called with the returned scope.
+/// Returns null if the tenant is out of range.
+TenantScope *beginTenantScope(swift::AsyncTask *task, unsigned tenant);
+
+/// Remove a tag added by beginTenantScope, if \p scope is not null.
+/// This must be called from the tagged task.
+void endTenantScope(TenantScope *scope);
+
+/// Let jobs age in the global queue: a priority level whose jobs have
+/// gone unserved for \p intervalNanos runs as if it were one level
+/// higher, for twice that as if two levels higher, and so on, so that
+/// lower priorities are never starved.  Zero, the default, disables
+/// aging.  Jobs on a worker's local deque do not age.
+void setPriorityAgingInterval(uint64_t intervalNanos);
+
+/// Queue-wait statistics for one priority level of the global queue.
+struct QueueWaitStatistics {
+  /// The number of jobs taken from the level.
+  uint64_t Dequeued;
+
+  /// How many of those were taken ahead of a higher level by aging.
+  uint64_t AgedDequeues;
+
+  /// The time that jobs have spent queued at the level, in total.
+  /// Divided by Dequeued, this is the mean queue wait.
+  uint64_t TotalWaitNanos;
+
+  /// The longest the level has gone without being served while it had
+  /// jobs queued.
+  uint64_t MaxWaitNanos;
+};
+
+/// Start or stop collecting queue-wait statistics.  Starting resets
+/// them.
+void setQueueStatisticsEnabled(bool enabled);
+
+/// Read the queue-wait statistics of priority level \p level, as given
+/// by swift::getJobPriorityLevel.  They are all zero for a level out of
+/// range.
+QueueWaitStatistics getQueueStatistics(unsigned level);
+
+/// Wake every thread that is idle in the global executor so that it
+/// re-evaluates the condition it is waiting on.
+void wakeGlobalExecutorThreads();
+
+/// A hook to let the global executor react when a job that may be
+/// waiting on it is escalated to \p newPriority, e.g. by moving it ahead
+/// of lower-priority jobs.  This is the counterpart of
+/// swift_task_enqueueGlobal_hook.
+SWIFT_CC(swift)
+extern void (*swift_task_escalateGlobal_hook)(swift::Job *job,
+                                              JobPriority newPriority);
+
+/// Tell the global executor that \p job was escalated, through
+/// swift_task_escalateGlobal_hook if it is set.  Call this after
+/// swift_task_escalate.  The job must not be queued on any other
+/// executor.
+void escalateGlobalJob(swift::Job *job, JobPriority newPriority);
+
+/// Enqueue \p job on \p executor: on the global executor if it is
+/// generic, and through swift_task_enqueue otherwise.
+void enqueueOnExecutor(swift::Job *job, swift::ExecutorRef executor);
+
+/// A serial executor defined in C++: it runs the jobs enqueued on it one
+/// at a time, in order.
+///
+/// The Swift runtime does not know about these executors, so there is no
+/// ExecutorRef for one.  Jobs are enqueued on it directly, and it runs
+/// them with the generic executor.
+class SerialExecutor {
+public:
+  /// Enqueue \p job to run after the jobs already enqueued.  This can be
+  /// called from any thread.
+  virtual void enqueue(swift::Job *job) = 0;
+
+  /// Whether the current thread is running this executor's jobs.
+  virtual bool isCurrent() const = 0;
+
+  /// The priority of the work that this executor runs, as a hint for
+  /// scheduling the threads that run it.
+  virtual JobPriority getPriorityHint() const = 0;
+
+protected:
+  ~SerialExecutor() = default;
+};
+
+/// Create a serial executor that works like a default actor: its jobs
+/// wait in a lock-free mailbox, and a thread of the global executor that
+/// enqueues on it while it is idle drains it inline; otherwise it is
+/// drained by a job on the global executor, directed at the worker that
+/// last drained it.
+/// \p priorityHint is what getPriorityHint returns.
+///
+/// The Swift runtime's default actors cannot use this, since the runtime
+/// owns their storage and the paths that enqueue on them.
+SerialExecutor *createMailboxExecutor(
+    JobPriority priorityHint = JobPriority::Default);
+
+/// Let go of an executor made by createMailboxExecutor.  It is freed once
+/// it has run the jobs already enqueued on it.
+void destroyMailboxExecutor(SerialExecutor *executor);
+
+/// Limit how many jobs, and for how many nanoseconds, a mailbox executor
+/// runs on a thread before it goes to the back of the global queue, so
+/// that a busy executor does not keep the thread to itself; 0 means no
+/// limit.  The default is 64 jobs or 1ms.
+void setMailboxDrainQuantum(size_t maxJobs, uint64_t maxNanos);
+
+/// Whether a thread of the global executor that enqueues on an idle
+/// mailbox executor drains it inline, up to a small nesting depth,
+/// instead of scheduling a job on the global executor.  This is on by
+/// default.
+void setMailboxInlineDrainEnabled(bool enabled);
+
+/// The job that the global executor is running on the current thread,
+/// or null.
+swift::Job *getRunningJob();
+
+/// Escalate \p task, which a task of priority \p waiterPriority is about
+/// to wait on, to \p waiterPriority, so that a high-priority task does
+/// not wait behind low-priority work.  Call this before suspending on
+/// the task's future; nothing calls it for a waiter on its own, and it
+/// does not cover task groups.  swift_task_escalate records the new
+/// priority on the task's children too, but only \p task itself moves
+/// up in the global queue; children that are queued keep their place.
+void inheritPriority(swift::AsyncTask *task, JobPriority waiterPriority);
+
+/// Enqueue \p job on the global executor once at least \p delayNanos
+/// nanoseconds have passed.  Returns an ID for cancelGlobalTimer, or 0
+/// if the job was enqueued right away.
+uint64_t enqueueGlobalAfter(swift::Job *job, uint64_t delayNanos);
+
+/// Cancel a timer started by enqueueGlobalAfter.  Returns its job if it
+/// had not been enqueued yet, or null.
+swift::Job *cancelGlobalTimer(uint64_t timerID);
+
+/// Call \p callback with \p context on \p executor, as a job of the given
+/// priority.
+void enqueueCallbackOnExecutor(swift::ExecutorRef executor,
+                               JobPriority priority,
+                               void (*callback)(void *), void *context);
+void enqueueCallbackOnExecutor(SerialExecutor *executor,
+                               JobPriority priority,
+                               void (*callback)(void *), void *context);
+
+/// Call \p callback with \p context on the global executor once at
+/// least \p delayNanos nanoseconds have passed.
+uint64_t enqueueGlobalCallbackAfter(uint64_t delayNanos, JobPriority priority,
+                                    void (*callback)(void *), void *context);
+
+/// Enqueue \p job on the global executor once \p fd is ready for
+/// reading, or for writing if \p forWriting.  Descriptors that cannot
+/// be waited on, such as regular files, count as ready right away.
+void enqueueGlobalWhenReady(swift::Job *job, int fd, bool forWriting);
+
+/// Call \p callback with \p context on the global executor once \p fd
+/// is ready for reading, or for writing if \p forWriting.
+void enqueueGlobalCallbackWhenReady(int fd, bool forWriting,
+                                    JobPriority priority,
+                                    void (*callback)(void *), void *context);
+
+/// Stop waiting for \p fd and enqueue every job that was waiting on it,
+/// as if it were ready.  Call this before closing a descriptor that jobs
+/// may be waiting on: closing it drops it from the epoll set silently,
+/// and they would otherwise wait forever.  A hangup or error on the
+/// descriptor releases its jobs without this.
+void unwatchGlobalDescriptor(int fd);
+
+/// The I/O operations that submitGlobalIO can perform.
+enum class IOOperation : uint8_t {
+  Read,
+  Write,
+  Accept,
+  Fsync,
+};
+
+/// Perform an I/O operation without blocking an executor thread, and
+/// then call \p callback on the global executor with \p context and the
+/// result: a byte count or accepted descriptor, or -errno.  Reads and
+/// writes use the descriptor's file position if \p offset is UINT64_MAX.
+///
+/// Operations go through io_uring where it is available, and are
+/// otherwise performed on an executor thread once the descriptor is
+/// ready, or on the blocking pool if it cannot be waited on.
+void submitGlobalIO(IOOperation operation, int fd, void *buffer,
+                    uint32_t length, uint64_t offset, JobPriority priority,
+                    void (*callback)(void *, int32_t), void *context);
+
+/// Call \p work with \p context on a thread of the blocking pool, an
+/// elastic set of threads apart from the global executor's, so that work
+/// which blocks, such as a synchronous system call, does not stall the
+/// executor.  The work typically resumes a continuation at the end,
+/// which enqueues the waiting task on the global executor again.
+void runBlocking(void (*work)(void *), void *context);
+
+/// Cap the number of threads of the blocking pool at \p maxThreads, 64
+/// by default, and let them exit after \p idleTimeoutNanos without work,
+/// 10 seconds by default.  Work beyond the cap waits for a free thread.
+void setBlockingPoolLimits(unsigned maxThreads, uint64_t idleTimeoutNanos);
+
+/// Exported forms of enqueueGlobalAfter and cancelGlobalTimer.
+extern "C" uint64_t swiftEnqueueGlobalAfter(swift::Job *job,
+                                            uint64_t delayNanos);
+extern "C" swift::Job *swiftCancelGlobalTimer(uint64_t timerID);
+
+/// Exported form of enqueueGlobalWhenReady.
+extern "C" void swiftEnqueueGlobalWhenReady(swift::Job *job, int fd,
+                                            bool forWriting);
+
+/// The number of priority levels that the global executor keeps
+/// separate run queues for.
+enum : unsigned { NumJobPriorityLevels = 6 };
+
+/// A bitmap with a bit set for every priority level.
+enum : uint32_t { AllJobPriorityLevels = (1u << NumJobPriorityLevels) - 1 };
+
+/// Map a job priority onto a dense priority level in the range
+/// [0, NumJobPriorityLevels).  Higher levels run first.  Priorities
+/// between the Dispatch QoS classes round down to the class below.
+inline unsigned getJobPriorityLevel(JobPriority priority) {
+  if (priority >= JobPriority::UserInteractive) return 5;
+  if (priority >= JobPriority::UserInitiated) return 4;
+  if (priority >= JobPriority::Default) return 3;
+  if (priority >= JobPriority::Utility) return 2;
+  if (priority >= JobPriority::Background) return 1;
+  return 0;
+}
+
+/// The band whose workers run jobs of priority level \p level.
+inline WorkerBand getWorkerBand(unsigned level) {
+  if (level == 5) return WorkerBand::Interactive;
+  if (level == 1 || level == 2) return WorkerBand::Background;
+  return WorkerBand::Default;
+}
+
 #define SWIFT_CONCURRENCY_COOPERATIVE_GLOBAL_EXECUTOR 1
 
+/// Whether the global executor can be switched to libdispatch with
+/// startGlobalExecutorOnDispatch.  Building with this set to 0 leaves
+/// out the dependency on libdispatch.
+#ifndef SWIFT_CONCURRENCY_ENABLE_DISPATCH
+#if defined(__APPLE__)
+#define SWIFT_CONCURRENCY_ENABLE_DISPATCH 1
+#elif defined(__has_include)
+#if __has_include(<dispatch/dispatch.h>)
+#define SWIFT_CONCURRENCY_ENABLE_DISPATCH 1
+#else
+#define SWIFT_CONCURRENCY_ENABLE_DISPATCH 0
+#endif
+#else
+#define SWIFT_CONCURRENCY_ENABLE_DISPATCH 0
+#endif
+#endif
+
 } // end namespace swift
 
 #endif
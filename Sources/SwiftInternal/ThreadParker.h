@@ -0,0 +1,191 @@
+//===--- ThreadParker.h - Blocking idle executor threads --------*- C++ -*-===//
+//
+// A parking lot for threads that have run out of work.  Idle threads
+// spin briefly and then block in the kernel (on a futex on Linux) until
+// another thread publishes work and unparks them.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef SWIFT_CONCURRENCY_THREADPARKER_H
+#define SWIFT_CONCURRENCY_THREADPARKER_H
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstdint>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#else
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#endif
+
+namespace my_swift {
+
+/// Hint to the CPU that we are in a spin-wait loop.
+inline void spinLoopHint() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+  __asm__ __volatile__("yield");
+#endif
+}
+
+/// Blocks idle threads until new work is published.
+///
+/// A waiter announces itself by bumping NumParked, re-checks for work,
+/// and then sleeps until Epoch changes.  A publisher makes its work
+/// visible first and only then looks at NumParked, so either the
+/// waiter sees the work or the publisher sees the waiter; the common
+/// case of publishing with nobody parked costs a fence and a load.
+class ThreadParker {
+  std::atomic<uint32_t> Epoch{0};
+  std::atomic<uint32_t> NumParked{0};
+
+  /// The number of times to poll for work before blocking.  This adapts
+  /// to how often spinning pays off.
+  std::atomic<uint32_t> SpinLimit{MinSpinLimit};
+
+  enum : uint32_t { MinSpinLimit = 16, MaxSpinLimit = 4096 };
+
+#if !defined(__linux__)
+  struct BlockingState {
+    std::mutex Lock;
+    std::condition_variable Condition;
+  };
+
+  /// Never destroyed, since detached threads may still be parked on it
+  /// while the process exits.
+  BlockingState *Blocking = new BlockingState();
+#endif
+
+  /// Sleep until Epoch moves on from \p epoch or, if \p timeoutNanos is
+  /// not UINT64_MAX, until that many nanoseconds have passed.  Only
+  /// unparkMatching with a mask that shares a bit with \p wakeMask, or
+  /// the other unpark functions, wake the thread.
+  void block(uint32_t epoch, uint64_t timeoutNanos, uint32_t wakeMask) {
+#if defined(__linux__)
+    // FUTEX_WAIT_BITSET takes an absolute deadline on CLOCK_MONOTONIC.
+    struct timespec deadline;
+    struct timespec *deadlinePtr = nullptr;
+    if (timeoutNanos != UINT64_MAX) {
+      clock_gettime(CLOCK_MONOTONIC, &deadline);
+      uint64_t nanos = uint64_t(deadline.tv_nsec) + timeoutNanos % 1000000000;
+      deadline.tv_sec += time_t(timeoutNanos / 1000000000 + nanos / 1000000000);
+      deadline.tv_nsec = long(nanos % 1000000000);
+      deadlinePtr = &deadline;
+    }
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&Epoch),
+            FUTEX_WAIT_BITSET_PRIVATE, epoch, deadlinePtr, nullptr,
+            wakeMask);
+#else
+    (void)wakeMask;
+    std::unique_lock<std::mutex> guard(Blocking->Lock);
+    auto epochChanged = [&] {
+      return Epoch.load(std::memory_order_relaxed) != epoch;
+    };
+    if (timeoutNanos == UINT64_MAX)
+      Blocking->Condition.wait(guard, epochChanged);
+    else
+      Blocking->Condition.wait_for(
+          guard, std::chrono::nanoseconds(timeoutNanos), epochChanged);
+#endif
+  }
+
+  void wake(int count) {
+#if defined(__linux__)
+    Epoch.fetch_add(1, std::memory_order_release);
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&Epoch),
+            FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+#else
+    std::lock_guard<std::mutex> guard(Blocking->Lock);
+    Epoch.fetch_add(1, std::memory_order_release);
+    if (count == 1)
+      Blocking->Condition.notify_one();
+    else
+      Blocking->Condition.notify_all();
+#endif
+  }
+
+  void unpark(int count) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (NumParked.load(std::memory_order_relaxed) != 0)
+      wake(count);
+  }
+
+public:
+  /// The wake mask of a thread that any unpark may wake.
+  static constexpr uint32_t AnyWaiter = 0xffffffff;
+
+  /// Wait until \p isReady returns true or another thread unparks this
+  /// one.  Spurious returns are possible, so callers should loop.
+  template <class Fn>
+  void park(Fn isReady) {
+    parkFor(UINT64_MAX, isReady);
+  }
+
+  /// Like park(), but give up after roughly \p timeoutNanos nanoseconds.
+  /// UINT64_MAX means no timeout.  \p wakeMask selects the calls to
+  /// unparkMatching that wake the thread.
+  template <class Fn>
+  void parkFor(uint64_t timeoutNanos, Fn isReady,
+               uint32_t wakeMask = AnyWaiter) {
+    auto spinLimit = SpinLimit.load(std::memory_order_relaxed);
+    for (uint32_t i = 0; i < spinLimit; ++i) {
+      if (isReady()) {
+        SpinLimit.store(std::min<uint32_t>(spinLimit * 2, MaxSpinLimit),
+                        std::memory_order_relaxed);
+        return;
+      }
+      spinLoopHint();
+    }
+    SpinLimit.store(std::max<uint32_t>(spinLimit / 2, MinSpinLimit),
+                    std::memory_order_relaxed);
+
+    auto epoch = Epoch.load(std::memory_order_acquire);
+    NumParked.fetch_add(1, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!isReady())
+      block(epoch, timeoutNanos, wakeMask);
+    NumParked.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  /// Wake one parked thread, if any.  Call this after publishing work.
+  void unparkOne() { unpark(1); }
+
+  /// Wake up to \p count parked threads.
+  void unparkMany(unsigned count) {
+    if (count)
+      unpark(int(std::min<unsigned>(count, INT_MAX)));
+  }
+
+  /// Wake every parked thread, if any.
+  void unparkAll() { unpark(INT_MAX); }
+
+  /// Wake the parked threads whose wake mask shares a bit with
+  /// \p wakeMask, and no others where the platform can tell them apart.
+  /// Returns whether it woke any.
+  bool unparkMatching(uint32_t wakeMask) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (NumParked.load(std::memory_order_relaxed) == 0)
+      return false;
+#if defined(__linux__)
+    Epoch.fetch_add(1, std::memory_order_release);
+    return syscall(SYS_futex, reinterpret_cast<uint32_t *>(&Epoch),
+                   FUTEX_WAKE_BITSET_PRIVATE, INT_MAX, nullptr, nullptr,
+                   wakeMask) > 0;
+#else
+    wake(INT_MAX);
+    return true;
+#endif
+  }
+};
+
+} // end namespace my_swift
+
+#endif
@@ -0,0 +1,266 @@
+//===--- TimerWheel.h - Hierarchical timing wheel ---------------*- C++ -*-===//
+//
+// A hierarchical timing wheel for jobs that should run after a delay.
+// Insertion and cancellation are O(1); advancing the clock costs O(1)
+// per expired timer plus a small amount per elapsed 64-tick block.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef SWIFT_CONCURRENCY_TIMERWHEEL_H
+#define SWIFT_CONCURRENCY_TIMERWHEEL_H
+
+#include "swift/ABI/Task.h"
+#include "llvm/Support/MathExtras.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace my_swift {
+
+/// A hierarchical timing wheel, in the style of Varghese and Lauck.
+///
+/// Time is measured in ticks.  Level L has 64 slots, each covering
+/// 64^L ticks.  A timer is filed at the level of the highest 6-bit
+/// group in which its expiry differs from the current tick, so that it
+/// is cascaded down one level each time the current tick reaches its
+/// slot, and fires exactly when the current tick reaches its expiry.
+///
+/// Timers live in a slab owned by the wheel and are named by a
+/// TimerID that carries a generation count, so a stale ID can be
+/// cancelled safely after its timer has fired.
+///
+/// This class is not thread-safe.
+class TimerWheel {
+public:
+  using TimerID = uint64_t;
+
+private:
+  enum : unsigned {
+    SlotBits = 6,
+    SlotsPerLevel = 1u << SlotBits,
+    NumLevels = 11, // 66 bits of ticks
+    ChunkBits = 12,
+    ChunkSize = 1u << ChunkBits,
+  };
+
+  struct Timer {
+    Timer *Next;
+    Timer *Prev;
+    uint64_t Expiry;
+    swift::Job *PendingJob;
+    uint32_t Index;
+    uint32_t Generation;
+  };
+
+  /// Circular lists of timers, one per slot, with sentinel heads.
+  Timer Slots[NumLevels][SlotsPerLevel];
+
+  /// Bit S of Occupied[L] is set iff slot S of level L is non-empty.
+  uint64_t Occupied[NumLevels] = {};
+
+  uint64_t CurrentTick;
+  size_t NumTimers = 0;
+
+  std::vector<std::unique_ptr<Timer[]>> Chunks;
+  Timer *FreeList = nullptr;
+
+  static unsigned slotIndex(uint64_t tick, unsigned level) {
+    return (tick >> (level * SlotBits)) & (SlotsPerLevel - 1);
+  }
+
+  Timer *lookup(TimerID id) {
+    auto index = uint32_t(id >> 32);
+    if ((index >> ChunkBits) >= Chunks.size())
+      return nullptr;
+    auto timer = &Chunks[index >> ChunkBits][index & (ChunkSize - 1)];
+    if (timer->Generation != uint32_t(id) || !timer->PendingJob)
+      return nullptr;
+    return timer;
+  }
+
+  Timer *allocate() {
+    if (!FreeList) {
+      std::unique_ptr<Timer[]> chunk(new Timer[ChunkSize]);
+      uint32_t base = uint32_t(Chunks.size()) << ChunkBits;
+      for (uint32_t i = 0; i < ChunkSize; ++i) {
+        chunk[i].Index = base + i;
+        chunk[i].Generation = 1;
+        chunk[i].PendingJob = nullptr;
+        chunk[i].Next = (i + 1 < ChunkSize) ? &chunk[i + 1] : nullptr;
+      }
+      FreeList = &chunk[0];
+      Chunks.push_back(std::move(chunk));
+    }
+    auto timer = FreeList;
+    FreeList = timer->Next;
+    return timer;
+  }
+
+  void deallocate(Timer *timer) {
+    timer->PendingJob = nullptr;
+    // Skip generation zero so that no TimerID is ever zero.
+    if (++timer->Generation == 0)
+      timer->Generation = 1;
+    timer->Next = FreeList;
+    FreeList = timer;
+  }
+
+  void link(Timer *timer, unsigned level, unsigned slot) {
+    auto head = &Slots[level][slot];
+    timer->Next = head;
+    timer->Prev = head->Prev;
+    head->Prev->Next = timer;
+    head->Prev = timer;
+    Occupied[level] |= (uint64_t(1) << slot);
+  }
+
+  void unlink(Timer *timer) {
+    timer->Prev->Next = timer->Next;
+    timer->Next->Prev = timer->Prev;
+  }
+
+  /// File a timer that expires after the current tick.
+  void file(Timer *timer) {
+    auto differing = timer->Expiry ^ CurrentTick;
+    auto level = unsigned(llvm::findLastSet(differing, llvm::ZB_Undefined)) /
+                 SlotBits;
+    link(timer, level, slotIndex(timer->Expiry, level));
+  }
+
+  /// Move every timer out of the given slot, calling \p expired for the
+  /// ones that are due and refiling the rest at a lower level.
+  template <class Fn>
+  void drainSlot(unsigned level, unsigned slot, Fn &expired) {
+    auto head = &Slots[level][slot];
+    if (!(Occupied[level] & (uint64_t(1) << slot)))
+      return;
+    Occupied[level] &= ~(uint64_t(1) << slot);
+
+    auto timer = head->Next;
+    head->Next = head->Prev = head;
+    while (timer != head) {
+      auto next = timer->Next;
+      if (timer->Expiry <= CurrentTick) {
+        auto job = timer->PendingJob;
+        deallocate(timer);
+        --NumTimers;
+        expired(job);
+      } else {
+        file(timer);
+      }
+      timer = next;
+    }
+  }
+
+  /// Process the current tick: cascade the higher levels whose slot
+  /// boundary has been reached, highest first, then fire level 0.
+  template <class Fn>
+  void processCurrentTick(Fn &expired) {
+    unsigned top = 0;
+    while (top + 1 < NumLevels && slotIndex(CurrentTick, top) == 0)
+      ++top;
+    for (unsigned level = top; level > 0; --level)
+      drainSlot(level, slotIndex(CurrentTick, level), expired);
+    drainSlot(0, slotIndex(CurrentTick, 0), expired);
+  }
+
+public:
+  explicit TimerWheel(uint64_t now) : CurrentTick(now) {
+    for (auto &level : Slots)
+      for (auto &head : level)
+        head.Next = head.Prev = &head;
+  }
+
+  TimerWheel(const TimerWheel &) = delete;
+  TimerWheel &operator=(const TimerWheel &) = delete;
+
+  uint64_t getCurrentTick() const { return CurrentTick; }
+
+  bool isEmpty() const { return NumTimers == 0; }
+
+  /// Schedule \p job to be handed back by advance() once the clock
+  /// reaches \p expiry, which must be after the current tick.
+  TimerID insert(swift::Job *job, uint64_t expiry) {
+    assert(expiry > CurrentTick && "timer is already due");
+    auto timer = allocate();
+    timer->Expiry = expiry;
+    timer->PendingJob = job;
+    file(timer);
+    ++NumTimers;
+    return (uint64_t(timer->Index) << 32) | timer->Generation;
+  }
+
+  /// Cancel a timer.  Returns its job if it had not fired yet, or null.
+  swift::Job *cancel(TimerID id) {
+    auto timer = lookup(id);
+    if (!timer)
+      return nullptr;
+    auto job = timer->PendingJob;
+
+    // If this is the only timer in its slot, both neighbours are the
+    // slot's head, and the slot becomes empty.
+    if (timer->Next == timer->Prev) {
+      auto offset = unsigned(timer->Next - &Slots[0][0]);
+      Occupied[offset / SlotsPerLevel] &=
+        ~(uint64_t(1) << (offset % SlotsPerLevel));
+    }
+    unlink(timer);
+    deallocate(timer);
+    --NumTimers;
+    return job;
+  }
+
+  /// Advance the clock to \p now, calling \p expired with the job of
+  /// every timer that expires on the way.
+  template <class Fn>
+  void advance(uint64_t now, Fn expired) {
+    while (CurrentTick < now) {
+      if (NumTimers == 0) {
+        CurrentTick = now;
+        return;
+      }
+
+      // Skip to the next occupied level-0 slot or the next block
+      // boundary, whichever comes first.
+      auto block = CurrentTick & ~uint64_t(SlotsPerLevel - 1);
+      auto ahead = Occupied[0] & ~((uint64_t(2) << slotIndex(CurrentTick, 0)) - 1);
+      uint64_t next = ahead
+        ? block + llvm::countTrailingZeros(ahead)
+        : block + SlotsPerLevel;
+      if (slotIndex(CurrentTick, 0) == SlotsPerLevel - 1)
+        next = block + SlotsPerLevel;
+      CurrentTick = std::min(next, now);
+      processCurrentTick(expired);
+    }
+  }
+
+  /// Return a tick at or before the earliest expiry of any timer, at
+  /// which advance() will have work to do, or UINT64_MAX if there are
+  /// no timers.
+  uint64_t getNextWakeTick() const {
+    if (NumTimers == 0)
+      return UINT64_MAX;
+    for (unsigned level = 0; level < NumLevels; ++level) {
+      if (!Occupied[level])
+        continue;
+      auto shift = level * SlotBits;
+      auto current = slotIndex(CurrentTick, level);
+      auto ahead = Occupied[level] & ~((uint64_t(2) << current) - 1);
+      if (current == SlotsPerLevel - 1)
+        ahead = 0;
+      // Timers are always filed ahead of the current slot, so an
+      // occupied slot must be later in the current rotation.
+      assert(ahead && "timer filed behind the current slot");
+      auto slot = llvm::countTrailingZeros(ahead);
+      auto base = (CurrentTick >> shift) & ~uint64_t(SlotsPerLevel - 1);
+      return (base + slot) << shift;
+    }
+    return UINT64_MAX;
+  }
+};
+
+} // end namespace my_swift
+
+#endif
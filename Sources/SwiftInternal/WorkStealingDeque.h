@@ -0,0 +1,73 @@
+//===--- WorkStealingDeque.h - Bounded work-stealing deque ------*- C++ -*-===//
+//
+// The per-priority deques of the global executor's workers, which the
+// owning worker pushes onto and any worker may claim from.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef SWIFT_CONCURRENCY_WORKSTEALINGDEQUE_H
+#define SWIFT_CONCURRENCY_WORKSTEALINGDEQUE_H
+
+#include "swift/ABI/Task.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace my_swift {
+
+/// A bounded work-stealing deque of jobs, in the style of Chase and Lev.
+///
+/// Only the owning worker pushes, at the bottom.  Unlike the classic
+/// deque, the owner claims from the top just like thieves do, so that
+/// jobs of equal priority keep running in FIFO order no matter which
+/// worker ends up claiming them.  When the deque is full, push fails
+/// and the caller must overflow into the global queue.
+class WorkStealingDeque {
+  enum : int64_t { Capacity = 256 };
+
+  std::atomic<int64_t> Top{0};
+  std::atomic<int64_t> Bottom{0};
+  std::atomic<swift::Job*> Slots[Capacity];
+
+public:
+  /// Push a job.  This must only be called by the owning worker.
+  bool push(swift::Job *job) {
+    auto bottom = Bottom.load(std::memory_order_relaxed);
+    auto top = Top.load(std::memory_order_acquire);
+    if (bottom - top >= Capacity)
+      return false;
+    Slots[bottom & (Capacity - 1)].store(job, std::memory_order_relaxed);
+    Bottom.store(bottom + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// Claim the oldest job.  This can be called from any thread.
+  swift::Job *steal() {
+    auto top = Top.load(std::memory_order_acquire);
+    while (top < Bottom.load(std::memory_order_acquire)) {
+      auto job = Slots[top & (Capacity - 1)].load(std::memory_order_relaxed);
+      if (Top.compare_exchange_weak(top, top + 1,
+                                    /*success*/ std::memory_order_acq_rel,
+                                    /*failure*/ std::memory_order_acquire))
+        return job;
+    }
+    return nullptr;
+  }
+
+  bool isEmpty() const {
+    return Top.load(std::memory_order_acquire) >=
+           Bottom.load(std::memory_order_acquire);
+  }
+
+  /// The number of jobs in the deque.  This can be called from any
+  /// thread, but the answer may of course be stale.
+  size_t size() const {
+    auto top = Top.load(std::memory_order_acquire);
+    auto bottom = Bottom.load(std::memory_order_acquire);
+    return bottom > top ? size_t(bottom - top) : 0;
+  }
+};
+
+} // end namespace my_swift
+
+#endif
@@ -1,2 +1,234 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 void swiftInstallConcurrencyEnqueueHook(void);
+
+/// Install the enqueue hook and run the global executor on a pool of
+/// `numWorkers` threads, or one per CPU if zero.
+void swiftInstallConcurrencyEnqueueHookWithWorkers(size_t numWorkers);
+
+/// Pin the workers of the global executor to NUMA nodes, in proportion
+/// to their CPUs, and have idle workers steal from their own node first.
+/// Call this before installing the enqueue hook with workers.
+void swiftSetNUMAPlacementEnabled(bool enabled);
+
+/// Install the enqueue hook and run the global executor on a separate
+/// group of workers for each priority band, at least one each: background
+/// and utility jobs on threads under SCHED_BATCH at a raised nice value,
+/// user-interactive jobs on threads under SCHED_FIFO if
+/// `realtimeInteractive` and permitted, and all others on ordinary
+/// threads.  Each band's threads only run that band's jobs.
+void swiftInstallConcurrencyEnqueueHookWithWorkerBands(
+    size_t numBackground, size_t numDefault, size_t numInteractive,
+    bool realtimeInteractive);
+
+/// Install the enqueue hook and run the global executor on libdispatch's
+/// global concurrent queues, one per QoS class.  Returns false, and
+/// installs the cooperative executor, if Dispatch is not available.
+bool swiftInstallConcurrencyEnqueueHookWithDispatch(void);
+
+/// Run the global executor's jobs on the current thread for at most
+/// `maxNanos` nanoseconds or `maxJobs` jobs, zero meaning no limit, or
+/// until there are none left.  Returns the number of jobs still queued.
+/// This lets an event loop drive the executor without a thread of its
+/// own:
+///
+///     int fd = swiftExecutorGetWakeFD();  // add to the loop's epoll set
+///     ...
+///     if (swiftExecutorRunFor(budget, 0) == 0)
+///         ...wait on fd for at most swiftExecutorGetTimeout() ns...
+size_t swiftExecutorRunFor(uint64_t maxNanos, size_t maxJobs);
+
+/// A descriptor that polls readable once there may be work for
+/// `swiftExecutorRunFor`, or -1 if unsupported.  Do not read or close it.
+int swiftExecutorGetWakeFD(void);
+
+/// How long the event loop may wait before calling `swiftExecutorRunFor`
+/// for the next timer, in nanoseconds: 0 if jobs are queued, or
+/// `UINT64_MAX` if nothing is pending.
+uint64_t swiftExecutorGetTimeout(void);
+
+/// Limit how many jobs, and for how many nanoseconds, a mailbox executor
+/// runs on a thread before it goes back to the global queue; 0 means no
+/// limit.
+void swiftSetMailboxDrainQuantum(size_t maxJobs, uint64_t maxNanos);
+
+/// Whether a thread of the global executor that enqueues on an idle
+/// mailbox executor runs its jobs inline instead of scheduling them.
+void swiftSetMailboxInlineDrainEnabled(bool enabled);
+
+/// Set how many jobs a worker of the global executor may have queued and
+/// still be sent the mailbox executors it drained last, so that their
+/// state stays in its caches; 0 turns this off.  The default is 8.
+void swiftSetWorkerAffinityThreshold(size_t maxQueuedJobs);
+
+/// A serial executor that runs its work on a thread of its own, apart
+/// from the global executor's threads.
+typedef struct SwiftDedicatedExecutor SwiftDedicatedExecutor;
+
+/// Start a dedicated executor, with its thread pinned to the `numCPUs`
+/// CPUs in `cpus` unless `numCPUs` is zero.  If `interactive`, the thread
+/// asks for real-time scheduling, which usually needs privileges.
+SwiftDedicatedExecutor *swiftCreateDedicatedExecutor(const uint32_t *cpus,
+                                                     size_t numCPUs,
+                                                     bool interactive);
+
+/// Run the work still enqueued on `executor`, stop its thread and free
+/// it.  Work enqueued after this runs on the global executor instead.
+void swiftDestroyDedicatedExecutor(SwiftDedicatedExecutor *executor);
+
+/// Call `work` with `context` on `executor`'s thread, after the work
+/// enqueued before it.
+void swiftRunOnDedicatedExecutor(SwiftDedicatedExecutor *executor,
+                                 void (*work)(void *), void *context);
+
+/// Whether the current thread is `executor`'s thread.
+bool swiftIsOnDedicatedExecutor(SwiftDedicatedExecutor *executor);
+
+/// A serial executor that works like a default actor: its work waits in
+/// a lock-free mailbox and runs on the global executor's threads, one
+/// item at a time.
+typedef struct SwiftMailboxExecutor SwiftMailboxExecutor;
+
+SwiftMailboxExecutor *swiftCreateMailboxExecutor(void);
+
+/// Let go of `executor`.  It is freed once its work has run.
+void swiftDestroyMailboxExecutor(SwiftMailboxExecutor *executor);
+
+/// Call `work` with `context` on `executor`, after the work enqueued
+/// before it.
+void swiftRunOnMailboxExecutor(SwiftMailboxExecutor *executor,
+                               void (*work)(void *), void *context);
+
+/// Whether the current thread is running `executor`'s work.
+bool swiftIsOnMailboxExecutor(SwiftMailboxExecutor *executor);
+
+/// Run tasks that carry a deadline earliest-deadline-first within their
+/// priority, ahead of tasks without one, which keep FIFO order.
+void swiftSetDeadlineSchedulingEnabled(bool enabled);
+
+/// Let a priority level of the global queue whose jobs have waited
+/// `intervalNanos` without being served run as if it were one level
+/// higher, and so on for each further interval.  Zero disables aging.
+void swiftSetPriorityAgingInterval(uint64_t intervalNanos);
+
+/// Queue-wait statistics for one priority level of the global queue.
+typedef struct SwiftQueueWaitStatistics {
+    /// Jobs taken from the level.
+    uint64_t dequeued;
+    /// Jobs taken from the level ahead of a higher level by aging.
+    uint64_t agedDequeues;
+    /// Total time spent queued by the level's jobs.
+    uint64_t totalWaitNanos;
+    /// The longest the level went unserved while it had jobs queued.
+    uint64_t maxWaitNanos;
+} SwiftQueueWaitStatistics;
+
+/// Start or stop collecting queue-wait statistics.  Starting resets them.
+void swiftSetQueueStatisticsEnabled(bool enabled);
+
+/// Read the statistics of priority `level`, from 0 for unspecified
+/// priority up to 5 for user-interactive.  They are all zero for any
+/// other level.
+void swiftGetQueueStatistics(size_t level, SwiftQueueWaitStatistics *stats);
+
+/// What the global executor does about new work once the number of
+/// queued jobs reaches the high-water mark.
+typedef enum SwiftAdmissionPolicy {
+    /// Accept everything.
+    SwiftAdmissionNone,
+    /// `swiftAdmitGlobalWork` rejects new work.
+    SwiftAdmissionReject,
+    /// `swiftAdmitGlobalWork` admits new work by cancelling a queued
+    /// task of lower priority, and rejects it if there is none.
+    SwiftAdmissionDropLowest,
+    /// `swiftAdmitGlobalWork` defers new work until the queue has
+    /// drained to half the high-water mark.
+    SwiftAdmissionBackpressure,
+} SwiftAdmissionPolicy;
+
+void swiftSetGlobalAdmissionPolicy(SwiftAdmissionPolicy policy,
+                                   size_t highWaterMark);
+
+/// The number of jobs enqueued on the global executor that have not
+/// started running yet.
+size_t swiftGetGlobalQueueDepth(void);
+
+typedef enum SwiftAdmissionResult {
+    SwiftAdmissionAdmitted,
+    SwiftAdmissionRejected,
+    /// Wait for `resume(context)`, which may already have been called.
+    SwiftAdmissionDeferred,
+} SwiftAdmissionResult;
+
+/// Ask whether new work of `priority`, the raw value of a `Task.Priority`,
+/// may be started under the admission policy.
+SwiftAdmissionResult swiftAdmitGlobalWork(uint8_t priority,
+                                          void (*resume)(void *),
+                                          void *context);
+
+/// Give `tenant` a share of each priority level of the global executor
+/// in proportion to `weight`, relative to the other tenants with jobs
+/// queued at that level.  Jobs without a tenant count as tenant 0.
+/// Every weight starts out as 1.  Tenants range from 0 to 63.
+void swiftSetTenantWeight(uint32_t tenant, uint32_t weight);
+
+/// Tag the task running on the current thread with `tenant`, from 1 to
+/// 63, until `swiftEndTenantScope` is called with the result from the
+/// same task.  Returns null, which may still be passed to
+/// `swiftEndTenantScope`, if no task is running or the tenant is out of
+/// range.
+void *swiftBeginTenantScope(uint32_t tenant);
+
+/// Remove the tag added by `swiftBeginTenantScope`.
+void swiftEndTenantScope(void *scope);
+
+/// Escalate `task`, an `AsyncTask` that a task of `priority`, the raw
+/// value of a `Task.Priority`, is about to wait on, to that priority.
+/// Only the awaited task moves up in the global queue; its queued child
+/// tasks keep their place.
+void swiftInheritPriority(void *task, uint8_t priority);
+
+/// Call `callback(context)` on the global executor once at least
+/// `delayNanos` nanoseconds have passed.
+void swiftScheduleGlobalCallbackAfter(uint64_t delayNanos,
+                                      void (*callback)(void *),
+                                      void *context);
+
+/// Call `callback(context)` on the global executor once `fd` is ready
+/// for reading, or for writing if `forWriting`.
+void swiftScheduleGlobalCallbackWhenReady(int fd, bool forWriting,
+                                          void (*callback)(void *),
+                                          void *context);
+
+/// Call the callbacks scheduled for `fd` becoming ready now, and stop
+/// watching it.  Call this before closing `fd` if any are pending, since
+/// they would otherwise never be called.
+void swiftUnwatchGlobalDescriptor(int fd);
+
+/// Call `work(context)` on a thread of the blocking pool, apart from the
+/// global executor's threads, so that it may block without stalling
+/// them.  To wait for it from a task, have it resume a continuation.
+void swiftRunBlocking(void (*work)(void *), void *context);
+
+/// Cap the blocking pool at `maxThreads` threads, and let them exit once
+/// they have been idle for `idleTimeoutNanos`.
+void swiftSetBlockingPoolLimits(size_t maxThreads, uint64_t idleTimeoutNanos);
+
+/// The I/O operations that `swiftSubmitGlobalIO` can perform.
+typedef enum SwiftIOOperation {
+    SwiftIORead,
+    SwiftIOWrite,
+    SwiftIOAccept,
+    SwiftIOFsync,
+} SwiftIOOperation;
+
+/// Perform an I/O operation without blocking an executor thread, using
+/// io_uring where it is available, and then call `callback(context,
+/// result)` on the global executor.  The result is a byte count or an
+/// accepted descriptor, or -errno.  Reads and writes use the descriptor's
+/// file position if `offset` is `UINT64_MAX`.
+void swiftSubmitGlobalIO(SwiftIOOperation operation, int fd, void *buffer,
+                         uint32_t length, uint64_t offset,
+                         void (*callback)(void *, int32_t), void *context);
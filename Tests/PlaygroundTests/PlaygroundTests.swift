@@ -29,6 +29,22 @@ final class PlaygroundTests: XCTestCase {
         XCTAssertEqual(output, "Hello, world!\n")
     }
 
+    func testExecutorDataStructures() throws {
+        // The queues and the timer wheel are C++, so their checks live in
+        // the ExecutorTests executable, which fails if any of them does.
+        guard #available(macOS 10.13, *) else {
+            return
+        }
+
+        let process = Process()
+        process.executableURL = productsDirectory.appendingPathComponent("ExecutorTests")
+
+        try process.run()
+        process.waitUntilExit()
+
+        XCTAssertEqual(process.terminationStatus, 0)
+    }
+
     /// Returns path to the built products directory.
     var productsDirectory: URL {
       #if os(macOS)
@@ -43,5 +59,6 @@ final class PlaygroundTests: XCTestCase {
 
     static var allTests = [
         ("testExample", testExample),
+        ("testExecutorDataStructures", testExecutorDataStructures),
     ]
 }